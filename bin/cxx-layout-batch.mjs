@@ -0,0 +1,257 @@
+#!/usr/bin/env node
+// Analyzes many files with the wasm build, for machines that can't build
+// the native tool.
+//
+//   node bin/cxx-layout-batch.mjs [options] <file>...
+//
+//   -o, --out-dir <dir>   where results go (default: cxx-layout-out)
+//   --args <args>         compiler arguments (default: --target=x86_64-pc-linux-gnu)
+//   --filter <regex>      only analyze records whose qualified name matches
+//   --type-names <style>  full, default or short: how field types are printed
+//   --target-description <file>
+//                         JSON data model overrides, as for the native tool
+//   --headers <prefix>    mount the archive written by scripts/pack-headers.mjs
+//   -j, --jobs <n>        number of workers (default: one per CPU)
+//
+// Each file is analyzed on its own, so includes only resolve against the
+// mounted header archive. Preprocess inputs (clang -E / gcc -E) when they
+// need project headers; .i/.ii output is analyzed without header search.
+//
+// For every input <path> the result is written to <out-dir>/<path>.json in
+// the native tool's {"file", "records": [...]} shape. Files are handed out
+// one at a time to a pool of worker threads, each of which keeps its own
+// module instance warm across files.
+
+import fs from 'node:fs';
+import os from 'node:os';
+import path from 'node:path';
+import { Worker, isMainThread, parentPort, workerData } from 'node:worker_threads';
+
+const DEFAULT_ARGS = '--target=x86_64-pc-linux-gnu';
+
+function usage() {
+    console.error('usage: cxx-layout-batch.mjs [-o <dir>] [--args <args>] [--filter <regex>] ' +
+        '[--type-names full|default|short] [--target-description <file>] [--headers <prefix>] [-j <n>] <file>...');
+    process.exit(1);
+}
+
+function parseOptions(argv) {
+    const options = {
+        outDir: 'cxx-layout-out',
+        args: DEFAULT_ARGS,
+        filter: '',
+        typeNames: 'default',
+        targetDescription: '',
+        headers: null,
+        jobs: os.availableParallelism?.() ?? os.cpus().length,
+        files: [],
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        const value = () => {
+            if (i + 1 >= argv.length) usage();
+            return argv[++i];
+        };
+        if (arg === '-o' || arg === '--out-dir') {
+            options.outDir = value();
+        } else if (arg === '--args') {
+            options.args = value();
+        } else if (arg === '--filter') {
+            options.filter = value();
+        } else if (arg === '--type-names') {
+            options.typeNames = value();
+            if (!['full', 'default', 'short'].includes(options.typeNames)) usage();
+        } else if (arg === '--target-description') {
+            options.targetDescription = fs.readFileSync(value(), 'utf8');
+        } else if (arg === '--headers') {
+            options.headers = value();
+        } else if (arg === '-j' || arg === '--jobs') {
+            options.jobs = Number(value());
+            if (!Number.isInteger(options.jobs) || options.jobs < 1) usage();
+        } else if (arg === '--') {
+            options.files.push(...argv.slice(i + 1));
+            break;
+        } else if (arg.startsWith('-')) {
+            usage();
+        } else {
+            options.files.push(arg);
+        }
+    }
+    if (options.files.length === 0) usage();
+    return options;
+}
+
+// <out-dir>/<file>.json, with absolute and parent paths kept inside out-dir
+function outputPath(outDir, file) {
+    const relative = path.relative(process.cwd(), path.resolve(file))
+        .split(path.sep)
+        .map(part => part === '..' ? '_' : part)
+        .join(path.sep);
+    return path.join(outDir, `${relative}.json`);
+}
+
+async function main() {
+    const options = parseOptions(process.argv.slice(2));
+    let headerArgs = '';
+    if (options.headers) {
+        const index = JSON.parse(fs.readFileSync(`${options.headers}.json`, 'utf8'));
+        headerArgs = index.args;
+    }
+
+    const queue = options.files.map(file => ({ file, output: outputPath(options.outDir, file) }));
+    const jobs = Math.min(options.jobs, queue.length);
+    const start = performance.now();
+    let records = 0;
+    let failed = 0;
+
+    const runWorker = () => new Promise((resolve, reject) => {
+        const worker = new Worker(new URL(import.meta.url), {
+            workerData: {
+                args: headerArgs ? `${options.args} ${headerArgs}` : options.args,
+                filter: options.filter,
+                typeNames: options.typeNames,
+                targetDescription: options.targetDescription,
+                headers: options.headers,
+            },
+        });
+        const next = () => {
+            const job = queue.shift();
+            if (job) {
+                worker.postMessage(job);
+            } else {
+                worker.terminate().then(resolve);
+            }
+        };
+        worker.on('message', message => {
+            if (message.type === 'setup-error') {
+                worker.terminate();
+                reject(new Error(message.error));
+                return;
+            }
+            if (message.type === 'ready') {
+                next();
+                return;
+            }
+            if (message.stderr) {
+                process.stderr.write(`${message.file}:\n${message.stderr}\n`);
+            }
+            if (message.error) {
+                failed++;
+                console.error(`${message.file}: ${message.error}`);
+            } else {
+                records += message.records;
+            }
+            next();
+        });
+        worker.on('error', reject);
+    });
+
+    await Promise.all(Array.from({ length: jobs }, runWorker));
+    const seconds = ((performance.now() - start) / 1000).toFixed(1);
+    console.log(`${options.files.length - failed} of ${options.files.length} files, ${records} records, ` +
+        `${jobs} worker${jobs === 1 ? '' : 's'}, ${seconds}s -> ${options.outDir}`);
+    process.exitCode = failed > 0 ? 1 : 0;
+}
+
+// Writes the headers of the archive at <prefix> into the module's file
+// system. They all share one read of the pack.
+function mountHeaders(module, prefix) {
+    const index = JSON.parse(fs.readFileSync(`${prefix}.json`, 'utf8'));
+    const pack = fs.readFileSync(`${prefix}.pack`);
+    const directories = new Set();
+    for (const [file, [offset, size]] of Object.entries(index.files)) {
+        const slash = file.lastIndexOf('/');
+        const dir = file.slice(0, slash);
+        if (!directories.has(dir)) {
+            module.FS.mkdirTree(dir);
+            directories.add(dir);
+        }
+        const data = new Uint8Array(pack.buffer, pack.byteOffset + offset, size);
+        module.FS.createDataFile(dir, file.slice(slash + 1), data, true, false, true);
+    }
+}
+
+async function workerMain() {
+    const { default: CxxLayout } = await import('../wasm/clang-cxx-layout.js');
+    let stderr = [];
+    const module = await CxxLayout({
+        print: line => stderr.push(line),
+        printErr: line => stderr.push(line),
+    });
+    // A module built before the exports this relies on fails on the first
+    // file otherwise.
+    const missing = ['_getAllLayouts', '_setRecordFilter', '_setTargetDescription', '_setTypeNameStyle']
+        .filter(name => typeof module[name] !== 'function');
+    if (workerData.headers && !module.FS) {
+        missing.push('FS');
+    }
+    if (missing.length > 0) {
+        parentPort.postMessage({
+            type: 'setup-error',
+            error: `wasm/clang-cxx-layout.js is too old, rebuild it (missing ${missing.join(', ')})`,
+        });
+        return;
+    }
+    if (workerData.headers) {
+        mountHeaders(module, workerData.headers);
+    }
+
+    const withString = (value, fn) => {
+        const size = Buffer.byteLength(value) + 1;
+        const ptr = module._malloc(size);
+        module.stringToUTF8(value, ptr, size);
+        try {
+            return fn(ptr);
+        } finally {
+            module._free(ptr);
+        }
+    };
+    const takeString = ptr => {
+        const value = module.UTF8ToString(ptr);
+        module._free(ptr);
+        return value;
+    };
+
+    // The arguments, filter, type names and data model are the same for
+    // every file
+    withString(workerData.args, ptr => module._setArgs(ptr));
+    withString(workerData.filter, ptr => module._setRecordFilter(ptr));
+    withString(workerData.typeNames, ptr => module._setTypeNameStyle(ptr));
+    const { error } = JSON.parse(takeString(withString(workerData.targetDescription,
+        ptr => module._setTargetDescription(ptr))));
+    if (error) {
+        parentPort.postMessage({ type: 'setup-error', error: `target description: ${error}` });
+        return;
+    }
+
+    parentPort.on('message', ({ file, output }) => {
+        stderr = [];
+        const result = { file };
+        try {
+            const source = fs.readFileSync(file, 'utf8');
+            withString(source, ptr => module._analyzeSource(ptr));
+            const records = takeString(module._getAllLayouts());
+            fs.mkdirSync(path.dirname(output), { recursive: true });
+            fs.writeFileSync(output, `{"file":${JSON.stringify(file)},"records":${records}}\n`);
+            // Only record entries have an "id" key, and quotes inside
+            // strings are escaped.
+            result.records = records.split('{"id":"').length - 1;
+        } catch (err) {
+            result.error = err.message;
+        } finally {
+            module._cleanup();
+        }
+        result.stderr = stderr.join('\n');
+        parentPort.postMessage(result);
+    });
+    parentPort.postMessage({ type: 'ready' });
+}
+
+if (isMainThread) {
+    main().catch(err => {
+        console.error(err.message);
+        process.exit(1);
+    });
+} else {
+    workerMain();
+}
@@ -0,0 +1,179 @@
+#include "CallingConv.h"
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/CodeGen/CGFunctionInfo.h"
+#include "clang/CodeGen/CodeGenABITypes.h"
+#include "clang/CodeGen/ModuleBuilder.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Triple.h"
+
+using namespace llvm;
+using clang::CodeGen::ABIArgInfo;
+
+namespace cxxlayout {
+
+AbiClassifier::AbiClassifier(clang::CompilerInstance &CI,
+                             clang::ASTContext &Ctx)
+    : Ctx(Ctx), LLVMCtx(std::make_unique<LLVMContext>()) {
+  Gen.reset(clang::CreateLLVMCodeGen(
+      CI.getDiagnostics(), "clang-cxx-layout",
+      CI.getFileManager().getVirtualFileSystemPtr(), CI.getHeaderSearchOpts(),
+      CI.getPreprocessorOpts(), CI.getCodeGenOpts(), *LLVMCtx));
+  Gen->Initialize(Ctx);
+}
+
+AbiClassifier::~AbiClassifier() = default;
+
+static const char *getKindName(const ABIArgInfo &Info) {
+  switch (Info.getKind()) {
+  case ABIArgInfo::Direct:
+    return "direct";
+  case ABIArgInfo::Extend:
+    return "extend";
+  case ABIArgInfo::Indirect:
+    return "indirect";
+  case ABIArgInfo::IndirectAliased:
+    return "indirect-aliased";
+  case ABIArgInfo::Ignore:
+    return "ignore";
+  case ABIArgInfo::Expand:
+    return "expand";
+  case ABIArgInfo::CoerceAndExpand:
+    return "coerce-and-expand";
+  case ABIArgInfo::InAlloca:
+    return "inalloca";
+  }
+  return "unknown";
+}
+
+// x86-64 SysV passes a record in registers as one coerced type per
+// eightbyte, so the classes can be read off the coerced type.
+static const char *getEightbyteClass(Type *Ty) {
+  if (Ty->isIntegerTy() || Ty->isPointerTy())
+    return "INTEGER";
+  if (Ty->isX86_FP80Ty())
+    return "X87";
+  if (Ty->isFloatingPointTy() || Ty->isVectorTy())
+    return "SSE";
+  return "MEMORY";
+}
+
+const AbiClass *AbiClassifier::classify(const clang::CXXRecordDecl *RD) {
+  auto [It, Inserted] = Cache.try_emplace(RD);
+  if (!Inserted)
+    return It->second ? &*It->second : nullptr;
+  if (!RD->isCompleteDefinition() || RD->isInvalidDecl() ||
+      RD->isDependentType() || RD->isAbstract())
+    return nullptr;
+
+  // A function taking and returning the record, as the C++ ABI lowers it:
+  // records that aren't trivial for calls are passed indirectly.
+  clang::CanQualType RecordTy =
+      Ctx.getCanonicalType(Ctx.getRecordType(RD));
+  const clang::CodeGen::CGFunctionInfo &Info =
+      clang::CodeGen::arrangeFreeFunctionCall(
+          Gen->CGM(), RecordTy, {RecordTy}, clang::FunctionType::ExtInfo(),
+          clang::CodeGen::RequiredArgs::All);
+  const ABIArgInfo &Arg = Info.arguments()[0].info;
+  const ABIArgInfo &Ret = Info.getReturnInfo();
+
+  AbiClass Class;
+  Class.pass = getKindName(Arg);
+  Class.inMemory = Arg.isIndirect() || Arg.isIndirectAliased() ||
+                   Arg.isInAlloca();
+  Class.sret = Ret.isIndirect() || (Ret.isInAlloca() && Ret.getInAllocaSRet());
+  Type *Coerce = nullptr;
+  if (Arg.isDirect() || Arg.isExtend())
+    Coerce = Arg.getCoerceToType();
+  else if (Arg.isCoerceAndExpand())
+    Coerce = Arg.getCoerceAndExpandType();
+  if (Coerce) {
+    raw_string_ostream OS(Class.coerceTo);
+    Coerce->print(OS);
+  }
+
+  const Triple &T = Ctx.getTargetInfo().getTriple();
+  if (T.getArch() == Triple::x86_64 && !T.isOSWindows()) {
+    if (Class.inMemory) {
+      Class.classes.push_back("MEMORY");
+    } else if (auto *Struct = dyn_cast_or_null<StructType>(Coerce)) {
+      for (Type *Element : Struct->elements())
+        Class.classes.push_back(getEightbyteClass(Element));
+    } else if (Coerce) {
+      Class.classes.push_back(getEightbyteClass(Coerce));
+    }
+  } else if (T.isAArch64() || T.isARM()) {
+    // Homogeneous aggregates are passed as an array of their members.
+    if (auto *Array = dyn_cast_or_null<ArrayType>(Coerce)) {
+      Type *Element = Array->getElementType();
+      if (Element->isFloatingPointTy())
+        Class.homogeneous = "HFA";
+      else if (Element->isVectorTy())
+        Class.homogeneous = "HVA";
+      if (!Class.homogeneous.empty())
+        Class.members = Array->getNumElements();
+    }
+  }
+  It->second = std::move(Class);
+  return &*It->second;
+}
+
+namespace {
+
+class ParamVisitor : public clang::RecursiveASTVisitor<ParamVisitor> {
+  AbiClassifier &Classifier;
+  const clang::ASTContext &Ctx;
+  std::vector<IndirectParam> &Params;
+
+public:
+  ParamVisitor(AbiClassifier &Classifier, const clang::ASTContext &Ctx,
+               std::vector<IndirectParam> &Params)
+      : Classifier(Classifier), Ctx(Ctx), Params(Params) {}
+
+  bool shouldVisitTemplateInstantiations() const { return true; }
+
+  bool VisitFunctionDecl(clang::FunctionDecl *FD) {
+    if (FD->isDependentContext() || FD != FD->getCanonicalDecl())
+      return true;
+    const clang::SourceManager &SM = Ctx.getSourceManager();
+    for (const clang::ParmVarDecl *Param : FD->parameters()) {
+      const clang::CXXRecordDecl *RD = Param->getType()->getAsCXXRecordDecl();
+      if (!RD || !(RD = RD->getDefinition()))
+        continue;
+      const AbiClass *Class = Classifier.classify(RD);
+      if (!Class || !Class->inMemory)
+        continue;
+      clang::SourceLocation Loc = SM.getExpansionLoc(Param->getLocation());
+      if (Loc.isInvalid() || SM.isInSystemHeader(Loc))
+        continue;
+      IndirectParam P;
+      P.function = FD->getQualifiedNameAsString();
+      clang::PresumedLoc PLoc = SM.getPresumedLoc(Loc);
+      if (PLoc.isValid()) {
+        P.file = PLoc.getFilename();
+        P.line = PLoc.getLine();
+      }
+      P.index = Param->getFunctionScopeIndex();
+      P.name = Param->getNameAsString();
+      P.type = Param->getType().getAsString(Ctx.getPrintingPolicy());
+      P.size = Ctx.getTypeSizeInChars(Param->getType()).getQuantity();
+      Params.push_back(std::move(P));
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+std::vector<IndirectParam> AbiClassifier::findIndirectParams() {
+  std::vector<IndirectParam> Params;
+  ParamVisitor(*this, Ctx, Params).TraverseAST(Ctx);
+  return Params;
+}
+
+} // namespace cxxlayout
@@ -0,0 +1,48 @@
+#ifndef CXXLAYOUT_CALLINGCONV_H
+#define CXXLAYOUT_CALLINGCONV_H
+
+#include "CxxLayout.h"
+
+#include "clang/AST/ASTContext.h"
+#include "llvm/ADT/DenseMap.h"
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace clang {
+class CodeGenerator;
+class CompilerInstance;
+} // namespace clang
+
+namespace llvm {
+class LLVMContext;
+} // namespace llvm
+
+namespace cxxlayout {
+
+// Classifies how records are passed and returned by value, the way clang's
+// code generation lowers a call for the target of the ASTContext. The
+// CodeGenModule this needs is built on an LLVM module that never gets any
+// code.
+class AbiClassifier {
+  clang::ASTContext &Ctx;
+  std::unique_ptr<llvm::LLVMContext> LLVMCtx;
+  std::unique_ptr<clang::CodeGenerator> Gen;
+  llvm::DenseMap<const clang::CXXRecordDecl *, std::optional<AbiClass>> Cache;
+
+public:
+  AbiClassifier(clang::CompilerInstance &CI, clang::ASTContext &Ctx);
+  ~AbiClassifier();
+
+  // Null for records that can't be passed by value: incomplete, invalid,
+  // dependent or abstract ones. Valid until the next call.
+  const AbiClass *classify(const clang::CXXRecordDecl *RD);
+
+  // The parameters of the functions outside system headers that take a
+  // record passed in memory by value.
+  std::vector<IndirectParam> findIndirectParams();
+};
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_CALLINGCONV_H
@@ -0,0 +1,273 @@
+#include "CopyDetector.h"
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtCXX.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+#include <algorithm>
+#include <tuple>
+
+using namespace llvm;
+
+namespace cxxlayout {
+
+static constexpr uint64_t LOOP_WEIGHT = 8;
+static constexpr unsigned MAX_LOOP_DEPTH = 4;
+
+namespace {
+
+enum class CopyKind {
+  RangeFor,
+  Capture,
+  Argument,
+  Initialization,
+  Return,
+  Assignment,
+  Other,
+};
+
+} // namespace
+
+static const char *getKindName(CopyKind Kind) {
+  switch (Kind) {
+  case CopyKind::RangeFor:
+    return "range-for";
+  case CopyKind::Capture:
+    return "capture";
+  case CopyKind::Argument:
+    return "argument";
+  case CopyKind::Initialization:
+    return "initialization";
+  case CopyKind::Return:
+    return "return";
+  case CopyKind::Assignment:
+    return "assignment";
+  case CopyKind::Other:
+    break;
+  }
+  return "copy";
+}
+
+// Contiguous standard containers can be passed as a view instead.
+static StringRef getViewType(const clang::CXXRecordDecl *RD) {
+  if (!RD->isInStdNamespace() || !RD->getIdentifier())
+    return "";
+  return StringSwitch<StringRef>(RD->getName())
+      .Cases("vector", "array", "std::span")
+      .Case("basic_string", "std::string_view")
+      .Default("");
+}
+
+static std::string getFix(CopyKind Kind, const clang::CXXRecordDecl *RD) {
+  switch (Kind) {
+  case CopyKind::RangeFor:
+    return "bind the loop variable by reference (const auto &)";
+  case CopyKind::Capture:
+    return "capture by reference, or move into the lambda "
+           "([x = std::move(x)])";
+  case CopyKind::Argument: {
+    std::string Fix = "take the parameter by const reference";
+    if (StringRef View = getViewType(RD); !View.empty())
+      Fix += (" or as " + View).str();
+    return Fix + ", or std::move the argument if it isn't used afterwards";
+  }
+  case CopyKind::Initialization:
+    return "bind a const reference, or std::move the source if it isn't "
+           "used afterwards";
+  case CopyKind::Return:
+    return "return a const reference if the source outlives the caller's "
+           "use of it";
+  case CopyKind::Assignment:
+  case CopyKind::Other:
+    break;
+  }
+  return "std::move the source if it isn't used afterwards";
+}
+
+namespace {
+
+class CopyVisitor : public clang::RecursiveASTVisitor<CopyVisitor> {
+  using Base = clang::RecursiveASTVisitor<CopyVisitor>;
+
+  clang::ASTContext &Ctx;
+  uint64_t MinSize;
+  std::vector<CopySite> &Sites;
+  unsigned LoopDepth = 0;
+  // The expressions that copies are made for, marked by their parents,
+  // which are visited first.
+  DenseMap<const clang::Expr *, CopyKind> Contexts;
+
+  void mark(const clang::Expr *E, CopyKind Kind) {
+    if (E)
+      Contexts.try_emplace(E->IgnoreImplicit(), Kind);
+  }
+
+  void addSite(clang::SourceLocation Loc, const clang::CXXRecordDecl *RD,
+               CopyKind Kind) {
+    if (!RD || RD->isInvalidDecl() || !RD->isCompleteDefinition() ||
+        RD->isDependentType())
+      return;
+    const clang::SourceManager &SM = Ctx.getSourceManager();
+    Loc = SM.getExpansionLoc(Loc);
+    if (Loc.isInvalid() || SM.isInSystemHeader(Loc))
+      return;
+    // The size analyzeRecord gives the record.
+    uint64_t Size = Ctx.getASTRecordLayout(RD).getSize().getQuantity();
+    if (Size < MinSize)
+      return;
+
+    CopySite Site;
+    clang::PresumedLoc PLoc = SM.getPresumedLoc(Loc);
+    if (PLoc.isValid()) {
+      Site.file = PLoc.getFilename();
+      Site.line = PLoc.getLine();
+      Site.column = PLoc.getColumn();
+    }
+    Site.kind = getKindName(Kind);
+    Site.type = Ctx.getRecordType(RD).getAsString(Ctx.getPrintingPolicy());
+    Site.size = Size;
+    Site.loopDepth = LoopDepth;
+    Site.bytes = Size;
+    for (unsigned I = 0, E = std::min(LoopDepth, MAX_LOOP_DEPTH); I != E; ++I)
+      Site.bytes *= LOOP_WEIGHT;
+    Site.fix = getFix(Kind, RD);
+    Sites.push_back(std::move(Site));
+  }
+
+  void addConstruct(const clang::CXXConstructExpr *E, CopyKind Kind) {
+    const clang::CXXConstructorDecl *Ctor = E->getConstructor();
+    if (Ctor && Ctor->isCopyConstructor() && !E->isElidable())
+      addSite(E->getBeginLoc(), Ctor->getParent(), Kind);
+  }
+
+  template <typename Fn> bool traverseLoop(Fn Traverse) {
+    ++LoopDepth;
+    bool Result = Traverse();
+    --LoopDepth;
+    return Result;
+  }
+
+public:
+  CopyVisitor(clang::ASTContext &Ctx, uint64_t MinSize,
+              std::vector<CopySite> &Sites)
+      : Ctx(Ctx), MinSize(MinSize), Sites(Sites) {}
+
+  bool shouldVisitTemplateInstantiations() const { return true; }
+
+  bool TraverseDecl(clang::Decl *D) {
+    if (const auto *FD = dyn_cast_or_null<clang::FunctionDecl>(D)) {
+      // Templates are checked through their instantiations.
+      if (FD->isDependentContext())
+        return true;
+      // What copy constructors and assignments copy is the copy made where
+      // they are called.
+      const auto *Ctor = dyn_cast<clang::CXXConstructorDecl>(FD);
+      const auto *Method = dyn_cast<clang::CXXMethodDecl>(FD);
+      if ((Ctor && Ctor->isCopyConstructor()) ||
+          (Method && Method->isCopyAssignmentOperator()))
+        return true;
+    }
+    return Base::TraverseDecl(D);
+  }
+  bool TraverseForStmt(clang::ForStmt *S) {
+    return traverseLoop([&] { return Base::TraverseForStmt(S); });
+  }
+  bool TraverseCXXForRangeStmt(clang::CXXForRangeStmt *S) {
+    if (const clang::VarDecl *Var = S->getLoopVariable())
+      mark(Var->getInit(), CopyKind::RangeFor);
+    return traverseLoop([&] { return Base::TraverseCXXForRangeStmt(S); });
+  }
+  bool TraverseWhileStmt(clang::WhileStmt *S) {
+    return traverseLoop([&] { return Base::TraverseWhileStmt(S); });
+  }
+  bool TraverseDoStmt(clang::DoStmt *S) {
+    return traverseLoop([&] { return Base::TraverseDoStmt(S); });
+  }
+
+  bool VisitLambdaExpr(clang::LambdaExpr *E) {
+    for (auto [Capture, Init] :
+         llvm::zip(E->captures(), E->capture_inits())) {
+      if (Capture.getCaptureKind() != clang::LCK_ByCopy || !Init)
+        continue;
+      // The inits of implicit captures, such as those of [=], aren't
+      // traversed, so their copies are added here.
+      if (Capture.isExplicit())
+        mark(Init, CopyKind::Capture);
+      else if (const auto *Construct = dyn_cast<clang::CXXConstructExpr>(
+                   Init->IgnoreImplicit()))
+        addConstruct(Construct, CopyKind::Capture);
+    }
+    return true;
+  }
+  bool VisitVarDecl(clang::VarDecl *D) {
+    mark(D->getInit(), CopyKind::Initialization);
+    return true;
+  }
+  bool VisitReturnStmt(clang::ReturnStmt *S) {
+    mark(S->getRetValue(), CopyKind::Return);
+    return true;
+  }
+  bool VisitCallExpr(clang::CallExpr *E) {
+    const auto *Method =
+        dyn_cast_or_null<clang::CXXMethodDecl>(E->getDirectCallee());
+    if (isa<clang::CXXOperatorCallExpr>(E) && Method &&
+        Method->isCopyAssignmentOperator()) {
+      // Taking the source by value, the copy is the argument's.
+      if (Method->getParamDecl(0)->getType()->isReferenceType())
+        addSite(E->getExprLoc(), Method->getParent(), CopyKind::Assignment);
+      else
+        mark(E->getArg(1), CopyKind::Assignment);
+      return true;
+    }
+    for (const clang::Expr *Arg : E->arguments())
+      mark(Arg, CopyKind::Argument);
+    return true;
+  }
+  bool VisitCXXConstructExpr(clang::CXXConstructExpr *E) {
+    for (const clang::Expr *Arg : E->arguments())
+      mark(Arg, CopyKind::Argument);
+    auto It = Contexts.find(E);
+    addConstruct(E, It == Contexts.end() ? CopyKind::Other : It->second);
+    return true;
+  }
+};
+
+} // namespace
+
+std::vector<CopySite> findCopies(clang::ASTContext &Ctx, uint64_t MinSize) {
+  std::vector<CopySite> Sites;
+  CopyVisitor(Ctx, MinSize, Sites).TraverseAST(Ctx);
+  return Sites;
+}
+
+void rankCopySites(std::vector<CopySite> &Sites) {
+  llvm::stable_sort(Sites, [](const CopySite &A, const CopySite &B) {
+    if (A.bytes != B.bytes)
+      return A.bytes > B.bytes;
+    return std::tie(A.file, A.line, A.column) <
+           std::tie(B.file, B.line, B.column);
+  });
+}
+
+void writeCopySitesJson(raw_ostream &OS, ArrayRef<CopySite> Sites) {
+  json::Array Out;
+  for (const CopySite &S : Sites)
+    Out.push_back(json::Object{{"file", S.file},
+                               {"line", S.line},
+                               {"column", S.column},
+                               {"kind", S.kind},
+                               {"type", S.type},
+                               {"size", static_cast<int64_t>(S.size)},
+                               {"loopDepth", S.loopDepth},
+                               {"bytes", static_cast<int64_t>(S.bytes)},
+                               {"fix", S.fix}});
+  OS << json::Value(std::move(Out));
+}
+
+} // namespace cxxlayout
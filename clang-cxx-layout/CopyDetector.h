@@ -0,0 +1,30 @@
+#ifndef CXXLAYOUT_COPYDETECTOR_H
+#define CXXLAYOUT_COPYDETECTOR_H
+
+#include "CxxLayout.h"
+
+#include "clang/AST/ASTContext.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <vector>
+
+namespace cxxlayout {
+
+// Finds the copy constructions and copy assignments of records of at least
+// MinSize bytes outside system headers: loop variables of range-for
+// statements, by-value lambda captures, by-value arguments, initializations,
+// returns and assignments. Each copy is weighted by the size of the record
+// and by 8 for each loop it is in, and comes with a suggested fix. Copies
+// that the language elides aren't reported.
+std::vector<CopySite> findCopies(clang::ASTContext &Ctx, uint64_t MinSize);
+
+// Sorts Sites by estimated bytes copied, most first.
+void rankCopySites(std::vector<CopySite> &Sites);
+
+void writeCopySitesJson(llvm::raw_ostream &OS,
+                        llvm::ArrayRef<CopySite> Sites);
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_COPYDETECTOR_H
@@ -1,15 +1,40 @@
 #include "clang/AST/ASTConsumer.h"
+#include "clang/AST/Attr.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclCXX.h"
+#include "clang/AST/PrettyPrinter.h"
+#include "clang/AST/QualTypeNames.h"
 #include "clang/AST/RecordLayout.h"
 #include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/FileManager.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/bit.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Regex.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/VirtualFileSystem.h"
 #include <memory>
 
+#include "CopyDetector.h"
 #include "CxxLayout.h"
+#ifdef CXXLAYOUT_CALLING_CONV
+#include "CallingConv.h"
+#endif
+#include "FieldAccess.h"
+#include "HeaderPruning.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -17,6 +42,14 @@
 #define EMSCRIPTEN_KEEPALIVE
 #endif
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
 using namespace clang::tooling;
 using namespace llvm;
 
@@ -24,22 +57,81 @@ using namespace cxxlayout;
 
 namespace cxxlayout {
 
-static const std::string DEFAULT_ARGS = "--target=x86_64-pc-linux-gnu";
-
-struct LayoutContext {
-  std::string args = DEFAULT_ARGS;
-  std::string recordList;
-  std::map<int64_t, FieldInfoPtr> records;
-};
+static constexpr unsigned DEFAULT_TIME_TRACE_GRANULARITY = 500; // in us
+static constexpr size_t TIME_TRACE_SUMMARY_ENTRIES = 10;
+static constexpr size_t LAYOUT_SUMMARY_ENTRIES = 20;
 
-inline static LayoutContext &getContext() {
+LayoutContext &getContext() {
   static LayoutContext C;
   return C;
 }
 
-static void writeEscaped(llvm::raw_ostream &OS, llvm::StringRef S) {
-  for (unsigned i = 0, e = S.size(); i < e; ++i) {
-    unsigned char C = static_cast<unsigned char>(S[i]);
+// Construct the context during static initialization rather than on the
+// first call from JS, so that -sEVAL_CTORS can snapshot it into the image.
+[[maybe_unused]] static LayoutContext &InitialContext = getContext();
+
+// The first byte in [P, End) that JSON strings have to escape: a quote, a
+// backslash or a control character. Names hardly ever have one, so this
+// checks a vector of bytes at a time where the target has them.
+static const char *findEscape(const char *P, const char *End) {
+#if defined(__AVX2__)
+  const __m256i Quote32 = _mm256_set1_epi8('"');
+  const __m256i Backslash32 = _mm256_set1_epi8('\\');
+  const __m256i MaxControl32 = _mm256_set1_epi8(0x1F);
+  for (; End - P >= 32; P += 32) {
+    __m256i V = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(P));
+    __m256i Hits = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(V, Quote32),
+                        _mm256_cmpeq_epi8(V, Backslash32)),
+        _mm256_cmpeq_epi8(_mm256_min_epu8(V, MaxControl32), V));
+    if (uint32_t Mask = _mm256_movemask_epi8(Hits))
+      return P + llvm::countr_zero(Mask);
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i Quote16 = _mm_set1_epi8('"');
+  const __m128i Backslash16 = _mm_set1_epi8('\\');
+  const __m128i MaxControl16 = _mm_set1_epi8(0x1F);
+  for (; End - P >= 16; P += 16) {
+    __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+    __m128i Hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(V, Quote16),
+                     _mm_cmpeq_epi8(V, Backslash16)),
+        _mm_cmpeq_epi8(_mm_min_epu8(V, MaxControl16), V));
+    if (uint32_t Mask = _mm_movemask_epi8(Hits))
+      return P + llvm::countr_zero(Mask);
+  }
+#elif defined(__wasm_simd128__)
+  const v128_t Quote = wasm_i8x16_splat('"');
+  const v128_t Backslash = wasm_i8x16_splat('\\');
+  const v128_t Space = wasm_i8x16_splat(0x20);
+  for (; End - P >= 16; P += 16) {
+    v128_t V = wasm_v128_load(P);
+    v128_t Hits = wasm_v128_or(
+        wasm_v128_or(wasm_i8x16_eq(V, Quote), wasm_i8x16_eq(V, Backslash)),
+        wasm_u8x16_lt(V, Space));
+    if (uint32_t Mask = wasm_i8x16_bitmask(Hits))
+      return P + llvm::countr_zero(Mask);
+  }
+#endif
+  for (; P != End; ++P) {
+    unsigned char C = static_cast<unsigned char>(*P);
+    if (C == '"' || C == '\\' || C < 0x20)
+      return P;
+  }
+  return End;
+}
+
+void writeEscaped(llvm::raw_ostream &OS, llvm::StringRef S) {
+  const char *End = S.end();
+  for (const char *P = S.begin(); P != End; ++P) {
+    // Runs of bytes that need no escaping are copied as they are.
+    const char *Escape = findEscape(P, End);
+    OS.write(P, Escape - P);
+    if (Escape == End)
+      break;
+    P = Escape;
+    unsigned char C = static_cast<unsigned char>(*P);
     switch (C) {
     case '"':
       OS << "\\\"";
@@ -63,16 +155,231 @@ static void writeEscaped(llvm::raw_ostream &OS, llvm::StringRef S) {
       OS << "\\t";
       break;
     default:
-      if (C < 0x20) {
-        static const char Hex[] = "0123456789ABCDEF";
-        OS << "\\u00" << Hex[(C >> 4) & 0xF] << Hex[C & 0xF];
-      } else {
-        OS << S[i];
-      }
+      static const char Hex[] = "0123456789ABCDEF";
+      OS << "\\u00" << Hex[(C >> 4) & 0xF] << Hex[C & 0xF];
+    }
+  }
+}
+
+void writeFieldJson(llvm::raw_ostream &Out, const FieldInfo &F) {
+  Out << '{';
+  Out << "\"fieldType\":\"" << fieldTypeToString(F.fieldType) << "\"";
+  if (!F.name.empty()) {
+    Out << ',';
+    Out << "\"name\":\"";
+    writeEscaped(Out, F.name);
+    Out << "\"";
+  }
+  Out << ',';
+  Out << "\"type\":\"";
+  writeEscaped(Out, F.type);
+  Out << "\"";
+  Out << ',';
+  Out << "\"size\":" << F.size.getQuantity();
+  Out << ',';
+  Out << "\"align\":" << F.align.getQuantity();
+  if (!F.fieldAlign.isZero()) {
+    Out << ',';
+    Out << "\"fieldAlign\":" << F.fieldAlign.getQuantity();
+  }
+  Out << ',';
+  Out << "\"offset\":" << (F.offset >> 3);
+  if (F.fieldType == FieldType::BitField) {
+    Out << ',';
+    Out << "\"bitWidth\":" << F.bitWidth;
+  }
+  if (F.declRange) {
+    Out << ',';
+    Out << "\"range\":[" << F.declRange->first << ',' << F.declRange->second
+        << ']';
+  }
+  if (F.accesses) {
+    Out << ',';
+    Out << "\"accesses\":" << F.accesses;
+  }
+  if (!F.affinities.empty()) {
+    Out << ',';
+    Out << "\"affinities\":[";
+    for (size_t I = 0, E = F.affinities.size(); I != E; ++I) {
+      if (I)
+        Out << ',';
+      Out << "{\"fields\":[\"";
+      writeEscaped(Out, F.affinities[I].first);
+      Out << "\",\"";
+      writeEscaped(Out, F.affinities[I].second);
+      Out << "\"],\"weight\":" << F.affinities[I].weight << '}';
+    }
+    Out << ']';
+  }
+  if (!F.proposedOrder.empty()) {
+    Out << ',';
+    Out << "\"proposedOrder\":[";
+    for (size_t I = 0, E = F.proposedOrder.size(); I != E; ++I) {
+      if (I)
+        Out << ',';
+      Out << '"';
+      writeEscaped(Out, F.proposedOrder[I]);
+      Out << '"';
+    }
+    Out << "],\"proposedSize\":" << F.proposedSize.getQuantity();
+  }
+  if (F.fieldType == FieldType::Record || F.fieldType == FieldType::NVBase) {
+    Out << ',';
+    Out << "\"subFields\": [";
+    bool first = true;
+    for (const auto &SFptr : F.subFields) {
+      if (!SFptr)
+        continue;
+      if (!first)
+        Out << ',';
+      writeFieldJson(Out, *SFptr);
+      first = false;
+    }
+    Out << ']';
+  }
+  Out << '}';
+}
+
+void writeAbiJson(llvm::raw_ostream &OS, const AbiClass &Abi) {
+  OS << "{\"pass\":\"" << Abi.pass << '"';
+  OS << ",\"inMemory\":" << (Abi.inMemory ? "true" : "false");
+  OS << ",\"sret\":" << (Abi.sret ? "true" : "false");
+  if (!Abi.coerceTo.empty()) {
+    OS << ",\"coerceTo\":\"";
+    writeEscaped(OS, Abi.coerceTo);
+    OS << '"';
+  }
+  if (!Abi.classes.empty()) {
+    OS << ",\"classes\":[";
+    for (size_t I = 0, E = Abi.classes.size(); I != E; ++I)
+      OS << (I ? "," : "") << '"' << Abi.classes[I] << '"';
+    OS << ']';
+  }
+  if (!Abi.homogeneous.empty())
+    OS << ",\"homogeneous\":\"" << Abi.homogeneous
+       << "\",\"members\":" << Abi.members;
+  OS << '}';
+}
+
+void writeIndirectParamsJson(llvm::raw_ostream &OS,
+                             const std::vector<IndirectParam> &Params) {
+  llvm::json::Array Out;
+  for (const IndirectParam &P : Params)
+    Out.push_back(llvm::json::Object{{"function", P.function},
+                                     {"file", P.file},
+                                     {"line", P.line},
+                                     {"index", P.index},
+                                     {"name", P.name},
+                                     {"type", P.type},
+                                     {"size", static_cast<int64_t>(P.size)}});
+  OS << llvm::json::Value(std::move(Out));
+}
+
+void writeRecordJson(llvm::raw_ostream &OS, int64_t Id,
+                     const FieldInfo &Record) {
+  OS << "{\"id\":\"" << Id << "\",\"name\":\"";
+  writeEscaped(OS, Record.type);
+  OS << '"';
+  if (!Record.file.empty()) {
+    OS << ",\"file\":\"";
+    writeEscaped(OS, Record.file);
+    OS << "\",\"line\":" << Record.line;
+  }
+  if (Record.abi) {
+    OS << ",\"abi\":";
+    writeAbiJson(OS, *Record.abi);
+  }
+  OS << ",\"layout\":";
+  writeFieldJson(OS, Record);
+  OS << '}';
+}
+
+void writeRecordsJson(llvm::raw_ostream &OS, const LayoutContext &Ctx) {
+  OS << '[';
+#ifdef __EMSCRIPTEN__
+  bool First = true;
+  for (const auto &R : Ctx.records) {
+    if (!First)
+      OS << ',';
+    writeRecordJson(OS, R.first, *R.second);
+    First = false;
+  }
+#else
+  // Records are independent, so they are written into buffers of their own
+  // on the thread pool and then copied out in order.
+  std::vector<const std::pair<const int64_t, FieldInfoPtr> *> Records;
+  Records.reserve(Ctx.records.size());
+  for (const auto &R : Ctx.records)
+    Records.push_back(&R);
+  std::vector<SmallString<0>> Buffers(Records.size());
+  llvm::parallelFor(0, Records.size(), [&](size_t I) {
+    llvm::raw_svector_ostream BufferOS(Buffers[I]);
+    writeRecordJson(BufferOS, Records[I]->first, *Records[I]->second);
+  });
+  for (size_t I = 0, E = Buffers.size(); I != E; ++I) {
+    if (I)
+      OS << ',';
+    OS << Buffers[I];
+  }
+#endif
+  OS << ']';
+}
+
+static void
+collectDataRanges(const FieldInfo &F, uint64_t Base, bool IncludeVPtr,
+                  std::vector<std::pair<uint64_t, uint64_t>> &Ranges) {
+  for (const FieldInfoPtr &Sub : F.subFields) {
+    if (!Sub)
+      continue;
+    uint64_t Offset = Base + (Sub->offset >> 3);
+    switch (Sub->fieldType) {
+    case FieldType::Record:
+    case FieldType::NVBase:
+    case FieldType::VBase:
+      collectDataRanges(*Sub, Offset, IncludeVPtr, Ranges);
+      break;
+    case FieldType::BitField: {
+      if (Sub->bitWidth == 0)
+        break;
+      uint64_t FirstBit = Base * 8 + Sub->offset;
+      Ranges.emplace_back(FirstBit / 8, (FirstBit + Sub->bitWidth + 7) / 8);
+      break;
+    }
+    case FieldType::VPtr:
+      if (!IncludeVPtr)
+        break;
+      [[fallthrough]];
+    case FieldType::Simple:
+      Ranges.emplace_back(Offset, Offset + Sub->size.getQuantity());
+      break;
     }
   }
 }
 
+std::vector<std::pair<uint64_t, uint64_t>>
+getDataRanges(const FieldInfo &Record, bool IncludeVPtr) {
+  std::vector<std::pair<uint64_t, uint64_t>> Ranges, Merged;
+  collectDataRanges(Record, 0, IncludeVPtr, Ranges);
+  llvm::sort(Ranges);
+  for (const auto &Range : Ranges) {
+    if (Range.first == Range.second)
+      continue;
+    if (!Merged.empty() && Range.first <= Merged.back().second)
+      Merged.back().second = std::max(Merged.back().second, Range.second);
+    else
+      Merged.push_back(Range);
+  }
+  return Merged;
+}
+
+uint64_t getPaddingBytes(const FieldInfo &Record) {
+  uint64_t Size = Record.size.getQuantity();
+  uint64_t Used = 0;
+  for (const auto &[Begin, End] : getDataRanges(Record, /*IncludeVPtr=*/true))
+    Used += std::min(End, Size) - std::min(Begin, Size);
+  return Size - Used;
+}
+
 static std::vector<std::string> splitArgs(const std::string &Args) {
   std::vector<std::string> Result;
   std::string Current;
@@ -91,6 +398,28 @@ static std::vector<std::string> splitArgs(const std::string &Args) {
   return Result;
 }
 
+// Removes -ftime-trace style options from Args, since the profiler is driven
+// by the tool itself rather than by cc1_main. Returns whether tracing was
+// requested.
+static bool takeTimeTraceArgs(std::vector<std::string> &Args,
+                              unsigned &Granularity) {
+  bool Enabled = false;
+  Granularity = DEFAULT_TIME_TRACE_GRANULARITY;
+  llvm::erase_if(Args, [&](const std::string &Arg) {
+    StringRef A(Arg);
+    if (A == "-ftime-trace" || A.starts_with("-ftime-trace=")) {
+      Enabled = true;
+      return true;
+    }
+    if (A.consume_front("-ftime-trace-granularity=")) {
+      A.getAsInteger(10, Granularity);
+      return true;
+    }
+    return false;
+  });
+  return Enabled;
+}
+
 static char *dupJson(const std::string &S) {
   char *Buf = static_cast<char *>(std::malloc(S.size() + 1));
   if (!Buf)
@@ -99,6 +428,101 @@ static char *dupJson(const std::string &S) {
   return Buf;
 }
 
+static std::optional<std::pair<unsigned, unsigned>>
+getSourceRange(const clang::ASTContext &Ctx, clang::SourceRange R) {
+  const clang::SourceManager &SM = Ctx.getSourceManager();
+  if (R.isInvalid() || R.getBegin().isMacroID() || R.getEnd().isMacroID() ||
+      !SM.isInMainFile(R.getBegin()))
+    return std::nullopt;
+  clang::SourceLocation End = clang::Lexer::getLocForEndOfToken(
+      R.getEnd(), 0, SM, Ctx.getLangOpts());
+  unsigned SourceOffset = getContext().sourceOffset;
+  unsigned Begin = SM.getFileOffset(R.getBegin());
+  if (End.isInvalid() || Begin < SourceOffset)
+    return std::nullopt;
+  return std::make_pair(Begin - SourceOffset,
+                        SM.getFileOffset(End) - SourceOffset);
+}
+
+static std::vector<std::string> getLayoutAnnotations(const clang::Decl *D) {
+  std::vector<std::string> Annotations;
+  for (const auto *A : D->specific_attrs<clang::AnnotateAttr>()) {
+    StringRef Annotation = A->getAnnotation();
+    if (Annotation.consume_front("layout:"))
+      Annotations.push_back(Annotation.str());
+  }
+  return Annotations;
+}
+
+std::optional<TypeNameStyle> parseTypeNameStyle(StringRef Name) {
+  return llvm::StringSwitch<std::optional<TypeNameStyle>>(Name)
+      .Case("full", TypeNameStyle::Full)
+      .Case("default", TypeNameStyle::Default)
+      .Case("short", TypeNameStyle::Short)
+      .Default(std::nullopt);
+}
+
+static clang::PrintingPolicy getTypeNamePolicy(const clang::ASTContext &Ctx,
+                                               TypeNameStyle Style) {
+  clang::PrintingPolicy Policy = Ctx.getPrintingPolicy();
+  Policy.SuppressDefaultTemplateArgs = Style != TypeNameStyle::Full;
+  Policy.SuppressScope = Style == TypeNameStyle::Short;
+  return Policy;
+}
+
+// The name of Type in the configured style, printed once per translation
+// unit.
+static std::string getTypeName(const clang::ASTContext &Ctx,
+                               clang::QualType Type) {
+  LayoutContext &LCtx = getContext();
+  auto [It, Inserted] = LCtx.typeNames.try_emplace(Type.getAsOpaquePtr());
+  if (Inserted)
+    It->second = Type.getAsString(getTypeNamePolicy(Ctx, LCtx.typeNameStyle));
+  return It->second;
+}
+
+static std::string getQualifiedName(const clang::NamedDecl *D) {
+  auto [It, Inserted] = getContext().declNames.try_emplace(D);
+  if (Inserted)
+    It->second = D->getQualifiedNameAsString();
+  return It->second;
+}
+
+static FieldInfoPtr analyzeRecord(const clang::ASTContext &Ctx,
+                                  const clang::CXXRecordDecl *RD);
+
+// Fills in the dimensions and element of a constant size array field.
+static void describeArray(const clang::ASTContext &Ctx,
+                          const clang::ConstantArrayType *Array,
+                          FieldInfo &Info) {
+  clang::QualType Element;
+  do {
+    Info.arrayDims.push_back(Array->getSize().getZExtValue());
+    Element = Array->getElementType();
+  } while ((Array = Ctx.getAsConstantArrayType(Element)));
+  Info.elementType = getTypeName(Ctx, Element);
+  Info.elementSize = Ctx.getTypeSizeInChars(Element);
+  if (const clang::CXXRecordDecl *ElementRecord =
+          Element->getAsCXXRecordDecl())
+    Info.element = analyzeRecord(Ctx, ElementRecord);
+}
+
+// The alignment a data member is laid out with, following the Itanium
+// record layout: the type's, lowered to 1 by packed, raised by alignas and
+// capped by #pragma pack.
+static clang::CharUnits getFieldAlign(const clang::ASTContext &Ctx,
+                                      const clang::FieldDecl *Field) {
+  const clang::RecordDecl *Parent = Field->getParent();
+  uint64_t Align = Ctx.getTypeAlign(Field->getType());
+  if (Field->hasAttr<clang::PackedAttr>() ||
+      Parent->hasAttr<clang::PackedAttr>())
+    Align = Ctx.getCharWidth();
+  Align = std::max<uint64_t>(Align, Field->getMaxAlignment());
+  if (const auto *Max = Parent->getAttr<clang::MaxFieldAlignmentAttr>())
+    Align = std::min<uint64_t>(Align, Max->getAlignment());
+  return Ctx.toCharUnitsFromBits(Align);
+}
+
 static FieldInfoPtr analyzeRecord(const clang::ASTContext &Ctx,
                                   const clang::CXXRecordDecl *RD) {
   assert(Ctx.getTargetInfo().getCXXABI().isItaniumFamily() &&
@@ -108,9 +532,11 @@ static FieldInfoPtr analyzeRecord(const clang::ASTContext &Ctx,
   const clang::ASTRecordLayout &Layout = Ctx.getASTRecordLayout(RD);
   Info->isValid = !RD->isInvalidDecl();
   Info->fieldType = FieldType::Record;
-  Info->type = RD->getQualifiedNameAsString();
+  Info->type = getQualifiedName(RD);
   Info->size = Layout.getSize();
   Info->align = Layout.getAlignment();
+  Info->hasVirtualBases = RD->getNumVBases() != 0;
+  Info->annotations = getLayoutAnnotations(RD);
 
   // First the vptr if any
   if (Layout.hasOwnVFPtr()) {
@@ -156,6 +582,12 @@ static FieldInfoPtr analyzeRecord(const clang::ASTContext &Ctx,
       SubFieldInfo = analyzeRecord(Ctx, FieldRecord);
       SubFieldInfo->name = Field->getNameAsString();
       SubFieldInfo->offset = Offset;
+      SubFieldInfo->fieldAlign = getFieldAlign(Ctx, Field);
+      SubFieldInfo->isPublic = Field->getAccess() != clang::AS_private &&
+                               Field->getAccess() != clang::AS_protected;
+      SubFieldInfo->declRange = getSourceRange(Ctx, Field->getSourceRange());
+      // The record's own annotations are on its top-level entry.
+      SubFieldInfo->annotations = getLayoutAnnotations(Field);
       Info->isValid &= SubFieldInfo->isValid;
       Info->subFields.push_back(std::move(SubFieldInfo));
     } else {
@@ -163,16 +595,24 @@ static FieldInfoPtr analyzeRecord(const clang::ASTContext &Ctx,
       SubFieldInfo->isValid = !Field->isInvalidDecl();
       Info->isValid &= SubFieldInfo->isValid;
       SubFieldInfo->name = Field->getNameAsString();
-      SubFieldInfo->type = Field->getType().getAsString();
+      SubFieldInfo->type = getTypeName(Ctx, Field->getType());
       SubFieldInfo->offset = Offset;
+      SubFieldInfo->isPublic = Field->getAccess() != clang::AS_private &&
+                               Field->getAccess() != clang::AS_protected;
       SubFieldInfo->size = Ctx.getTypeSizeInChars(Field->getType());
       SubFieldInfo->align = Ctx.getTypeAlignInChars(Field->getType());
+      SubFieldInfo->declRange = getSourceRange(Ctx, Field->getSourceRange());
+      SubFieldInfo->annotations = getLayoutAnnotations(Field);
+      if (const clang::ConstantArrayType *Array =
+              Ctx.getAsConstantArrayType(Field->getType()))
+        describeArray(Ctx, Array, *SubFieldInfo);
       if (Field->isBitField()) {
         SubFieldInfo->fieldType = FieldType::BitField;
         SubFieldInfo->bitWidth = Field->getBitWidthValue();
         Info->subFields.push_back(std::move(SubFieldInfo));
       } else {
         SubFieldInfo->fieldType = FieldType::Simple;
+        SubFieldInfo->fieldAlign = getFieldAlign(Ctx, Field);
         Info->subFields.push_back(std::move(SubFieldInfo));
       }
     }
@@ -185,32 +625,158 @@ static FieldInfoPtr analyzeRecord(const clang::ASTContext &Ctx,
   return Info;
 }
 
+// Whether RD can be named from code outside of it, e.g. a generated header:
+// it and its enclosing classes have names, none is local to a function or in
+// an anonymous namespace, and nested ones are public.
+static bool isSpellable(const clang::CXXRecordDecl *RD) {
+  if (RD->isInAnonymousNamespace())
+    return false;
+  for (const clang::DeclContext *DC = RD; !DC->isFileContext();
+       DC = DC->getParent()) {
+    const auto *Class = dyn_cast<clang::CXXRecordDecl>(DC);
+    if (!Class || Class->isLambda() ||
+        (!Class->getIdentifier() && !Class->getTypedefNameForAnonDecl()))
+      return false;
+    if (Class->getParent()->isRecord() &&
+        (Class->getAccess() == clang::AS_private ||
+         Class->getAccess() == clang::AS_protected))
+      return false;
+  }
+  return true;
+}
+
 class RecursiveDeclVisitor
     : public clang::RecursiveASTVisitor<RecursiveDeclVisitor> {
   LayoutContext &LCtx;
+  std::optional<llvm::Regex> Filter;
+  llvm::DenseSet<int64_t> Seen;
+  const FieldAccessCollector *Accesses;
+#ifdef CXXLAYOUT_CALLING_CONV
+  AbiClassifier *Abi = nullptr;
+#endif
 
 public:
-  RecursiveDeclVisitor() : LCtx(getContext()) {}
+  llvm::SmallVector<const clang::CXXRecordDecl *> Matched;
+
+  explicit RecursiveDeclVisitor(const FieldAccessCollector *Accesses)
+      : LCtx(getContext()), Accesses(Accesses) {
+    if (LCtx.recordFilter.empty())
+      return;
+    Filter.emplace(LCtx.recordFilter);
+    std::string Error;
+    if (!Filter->isValid(Error)) {
+      llvm::errs() << "invalid record filter '" << LCtx.recordFilter
+                   << "': " << Error << "\n";
+      Filter.reset();
+    }
+  }
   bool VisitCXXRecordDecl(clang::CXXRecordDecl *RD) {
     if (!RD || !RD->isCompleteDefinition())
       return true;
     int64_t Id = RD->getID();
-    if (LCtx.records.find(Id) != LCtx.records.end())
+    if (!Seen.insert(Id).second)
       return true;
-    FieldInfoPtr Info = analyzeRecord(RD->getASTContext(), RD);
-    LCtx.records[Id] = std::move(Info);
+    if (Filter && !Filter->match(getQualifiedName(RD)))
+      return true;
+    Matched.push_back(RD);
+    llvm::TimeTraceScope TimeScope("AnalyzeRecord",
+                                   [&]() { return getQualifiedName(RD); });
+    const clang::ASTContext &Ctx = RD->getASTContext();
+    FieldInfoPtr Info = analyzeRecord(Ctx, RD);
+    if (Accesses)
+      Accesses->annotate(RD, *Info);
+#ifdef CXXLAYOUT_CALLING_CONV
+    if (Abi)
+      if (const AbiClass *Class = Abi->classify(RD))
+        Info->abi = *Class;
+#endif
+    // Presumed locations follow line markers, so records of preprocessed
+    // input are attributed to the files they were written in.
+    clang::PresumedLoc PLoc =
+        Ctx.getSourceManager().getPresumedLoc(RD->getLocation());
+    if (PLoc.isValid()) {
+      Info->file = PLoc.getFilename();
+      Info->line = PLoc.getLine();
+    }
+    if (isSpellable(RD))
+      Info->spelling = clang::TypeName::getFullyQualifiedName(
+          Ctx.getRecordType(RD), Ctx, Ctx.getPrintingPolicy(),
+          /*WithGlobalNsPrefix=*/true);
+    if (LCtx.recordSink)
+      LCtx.recordSink(Id, *Info);
+    else
+      LCtx.records[Id] = std::move(Info);
     return true;
   }
+#ifdef CXXLAYOUT_CALLING_CONV
+  void setAbiClassifier(AbiClassifier *Classifier) { Abi = Classifier; }
+#endif
 };
 
 class Consumer : public clang::ASTConsumer {
   LayoutContext &LCtx;
+  clang::CompilerInstance &CI;
 
 public:
-  Consumer(clang::CompilerInstance &CI) : LCtx(getContext()) {}
+  std::set<clang::FileID> MacroFiles;
+  std::vector<unsigned> DirectiveLines;
+
+  Consumer(clang::CompilerInstance &CI) : LCtx(getContext()), CI(CI) {}
   void HandleTranslationUnit(clang::ASTContext &Ctx) override {
-    RecursiveDeclVisitor V;
+    llvm::TimeTraceScope TimeScope("AnalyzeLayouts");
+    LCtx.targetTriple = Ctx.getTargetInfo().getTriple().str();
+    const clang::SourceManager &SM = Ctx.getSourceManager();
+    clang::OptionalFileEntryRef MainFile =
+        SM.getFileEntryRefForID(SM.getMainFileID());
+    for (const auto &Entry :
+         llvm::make_range(SM.fileinfo_begin(), SM.fileinfo_end()))
+      if (!MainFile || Entry.first != *MainFile)
+        LCtx.includedFiles.push_back(Entry.first.getName().str());
+    std::optional<FieldAccessCollector> Accesses;
+    if (LCtx.analyzeAccesses) {
+      llvm::TimeTraceScope TimeScope("CollectFieldAccesses");
+      Accesses.emplace();
+      Accesses->collect(Ctx);
+    }
+    RecursiveDeclVisitor V(Accesses ? &*Accesses : nullptr);
+#ifdef CXXLAYOUT_CALLING_CONV
+    std::optional<AbiClassifier> Abi;
+    // setAbiClassification and setTargetDescription keep these apart.
+    if (LCtx.classifyAbi && !LCtx.targetDescription) {
+      Abi.emplace(CI, Ctx);
+      V.setAbiClassifier(&*Abi);
+    }
+#endif
     V.TraverseDecl(Ctx.getTranslationUnitDecl());
+#ifdef CXXLAYOUT_CALLING_CONV
+    if (Abi) {
+      llvm::TimeTraceScope TimeScope("FindIndirectParams");
+      LCtx.indirectParams = Abi->findIndirectParams();
+    }
+#endif
+    if (LCtx.copyMinSize) {
+      llvm::TimeTraceScope TimeScope("FindCopies");
+      LCtx.copySites = findCopies(Ctx, LCtx.copyMinSize);
+      rankCopySites(LCtx.copySites);
+    }
+    LCtx.typeNames.clear();
+    LCtx.declNames.clear();
+    if (!LCtx.collectHeaderDeps)
+      return;
+    // Everything the main file declares has to compile in the pruned run,
+    // not only the matching records.
+    HeaderDependencyCollector Deps(SM);
+    for (const clang::CXXRecordDecl *RD : V.Matched)
+      Deps.addDecl(RD);
+    for (const clang::Decl *D : Ctx.getTranslationUnitDecl()->decls())
+      if (!D->isImplicit() &&
+          SM.isInMainFile(SM.getExpansionLoc(D->getLocation())))
+        Deps.addUses(D);
+    for (clang::FileID FID : MacroFiles)
+      Deps.addFile(FID);
+    LCtx.prunedIncludes = Deps.getIncludes();
+    LCtx.prunedDirectives = getProcessedIncludes(
+        SM.getBufferData(SM.getMainFileID()), DirectiveLines);
   }
 };
 
@@ -219,12 +785,182 @@ class Action : public clang::ASTFrontendAction {
 
 public:
   Action() : LCtx(getContext()) {}
+  bool BeginInvocation(clang::CompilerInstance &CI) override {
+    // The target exists by now, the preprocessor and AST don't yet.
+    if (LCtx.targetDescription && CI.hasTarget())
+      LCtx.targetDescription->apply(CI.getTarget());
+    return true;
+  }
   std::unique_ptr<clang::ASTConsumer>
   CreateASTConsumer(clang::CompilerInstance &CI, StringRef InFile) override {
-    return std::make_unique<Consumer>(CI);
+    auto C = std::make_unique<Consumer>(CI);
+    if (LCtx.collectHeaderDeps) {
+      clang::Preprocessor &PP = CI.getPreprocessor();
+      PP.addPPCallbacks(
+          createMacroUseCollector(CI.getSourceManager(), C->MacroFiles));
+      PP.addPPCallbacks(createIncludeDirectiveCollector(
+          CI.getSourceManager(), C->DirectiveLines));
+    }
+    return C;
   }
 };
 
+// Like runToolOnCodeWithArgs, but lets the caller choose the diagnostic
+// consumer.
+static bool runTool(std::unique_ptr<clang::FrontendAction> ToolAction,
+                    StringRef Code, const std::vector<std::string> &Args,
+                    StringRef FileName,
+                    clang::DiagnosticConsumer *DiagConsumer = nullptr) {
+  auto OverlayFS = llvm::makeIntrusiveRefCnt<llvm::vfs::OverlayFileSystem>(
+      llvm::vfs::getRealFileSystem());
+  auto InMemoryFS = llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+  OverlayFS->pushOverlay(InMemoryFS);
+  InMemoryFS->addFile(FileName, 0, llvm::MemoryBuffer::getMemBufferCopy(Code));
+  auto Files = llvm::makeIntrusiveRefCnt<clang::FileManager>(
+      clang::FileSystemOptions(), OverlayFS);
+
+  std::vector<std::string> CommandLine = {"clang-tool", "-fsyntax-only"};
+  llvm::append_range(CommandLine,
+                     getClangStripDependencyFileAdjuster()(Args, FileName));
+  CommandLine.push_back(FileName.str());
+  ToolInvocation Invocation(std::move(CommandLine), std::move(ToolAction),
+                            Files.get());
+  if (DiagConsumer)
+    Invocation.setDiagnosticConsumer(DiagConsumer);
+  return Invocation.run();
+}
+
+static std::string getPruneKey(StringRef Source,
+                               const std::vector<std::string> &Args) {
+  std::string Key = llvm::join(Args, " ");
+  Key.push_back('\n');
+  Key.append(getContext().recordFilter);
+  Key.push_back('\n');
+  if (getContext().targetDescription)
+    Key.append(getContext().targetDescription->str());
+  Key.push_back('\n');
+  Key.append(getIncludeLines(Source));
+  return Key;
+}
+
+// Analyzes Source with only the pruned include set. Diagnostics are held
+// back until the run is known to be good, since a failing run means the set
+// is stale and the caller starts over with the full includes.
+static bool runPrunedAnalysis(StringRef Source,
+                              const std::vector<std::string> &Args,
+                              StringRef FileName) {
+  LayoutContext &Ctx = getContext();
+  std::optional<std::string> Pruned = buildPrunedSource(
+      Source, Ctx.prunedIncludes, Ctx.prunedDirectives, FileName);
+  if (!Pruned)
+    return false;
+  std::string Diags;
+  llvm::raw_string_ostream DiagOS(Diags);
+  auto DiagOpts = llvm::makeIntrusiveRefCnt<clang::DiagnosticOptions>();
+  clang::TextDiagnosticPrinter Printer(DiagOS, DiagOpts.get());
+  Ctx.sourceOffset = Pruned->size() - Source.size();
+  bool Success =
+      runTool(std::make_unique<Action>(), *Pruned, Args, FileName, &Printer);
+  Ctx.sourceOffset = 0;
+  if (!Success || Printer.getNumErrors() != 0) {
+    Ctx.records.clear();
+    Ctx.includedFiles.clear();
+    return false;
+  }
+  DiagOS.flush();
+  llvm::errs() << Diags;
+  return true;
+}
+
+static bool isPreprocessedFileName(StringRef FileName) {
+  return FileName.ends_with(".i") || FileName.ends_with(".ii");
+}
+
+// Returns whether Source compiled without errors.
+static bool runAnalysis(StringRef Source, const std::vector<std::string> &Args,
+                        StringRef FileName) {
+  LayoutContext &Ctx = getContext();
+  // Preprocessed input has no #include directives left to prune, access
+  // and copy analysis need the function bodies of every header, and the
+  // indirect parameters are of the functions declared in them.
+  if (!Ctx.pruneHeaders || Ctx.analyzeAccesses || Ctx.copyMinSize ||
+      Ctx.classifyAbi || isPreprocessedFileName(FileName))
+    return runTool(std::make_unique<Action>(), Source, Args, FileName);
+
+  std::string Key = getPruneKey(Source, Args);
+  if (Key == Ctx.unprunableKey)
+    return runTool(std::make_unique<Action>(), Source, Args, FileName);
+  bool Pruned = Key == Ctx.pruneKey;
+  if (Pruned && runPrunedAnalysis(Source, Args, FileName))
+    return true;
+  std::vector<std::string> FailedIncludes;
+  if (Pruned)
+    FailedIncludes = std::move(Ctx.prunedIncludes);
+  Ctx.collectHeaderDeps = true;
+  bool Success = runTool(std::make_unique<Action>(), Source, Args, FileName);
+  Ctx.collectHeaderDeps = false;
+  if (Success && Pruned && Ctx.prunedIncludes == FailedIncludes) {
+    // The same include set would fail again, and every analysis would
+    // parse twice.
+    Ctx.unprunableKey = std::move(Key);
+    Ctx.pruneKey.clear();
+    Ctx.prunedIncludes.clear();
+    Ctx.prunedDirectives.clear();
+  } else if (Success) {
+    Ctx.pruneKey = std::move(Key);
+  } else {
+    Ctx.pruneKey.clear();
+    Ctx.prunedIncludes.clear();
+    Ctx.prunedDirectives.clear();
+  }
+  return Success;
+}
+
+bool isPreprocessedSource(StringRef Source) {
+  // Preprocessor output starts with a line marker such as `# 1 "file.cpp"`.
+  StringRef Line = Source.ltrim().split('\n').first;
+  if (!Line.consume_front("#"))
+    return false;
+  Line = Line.ltrim(" \t");
+  Line.consume_front("line");
+  Line = Line.ltrim(" \t");
+  return !Line.empty() && llvm::isDigit(Line.front());
+}
+
+void analyzeCode(StringRef Code, StringRef FileName) {
+  auto &Ctx = getContext();
+  Ctx.recordList.clear();
+  Ctx.records.clear();
+  Ctx.pathIndexes.clear();
+  Ctx.copySites.clear();
+  Ctx.indirectParams.clear();
+  Ctx.timeTrace.clear();
+  Ctx.targetTriple.clear();
+  Ctx.includedFiles.clear();
+  std::vector<std::string> ToolArgs = splitArgs(Ctx.args);
+  unsigned Granularity;
+  bool TimeTrace = takeTimeTraceArgs(ToolArgs, Granularity);
+  if (isPreprocessedFileName(FileName)) {
+    // Line markers are kept, so the preprocessor only has to lex, and there
+    // is nothing left to search headers for. .i is taken as C++ as well.
+    llvm::append_range(ToolArgs, std::initializer_list<const char *>{
+                                     "-x", "c++-cpp-output", "-nostdinc"});
+  }
+  if (TimeTrace)
+    llvm::timeTraceProfilerInitialize(Granularity, "clang-cxx-layout");
+  {
+    llvm::TimeTraceScope TimeScope("AnalyzeSource");
+    Ctx.hasErrors = !runAnalysis(Code, ToolArgs, FileName);
+  }
+  if (TimeTrace) {
+    SmallString<0> Trace;
+    llvm::raw_svector_ostream OS(Trace);
+    llvm::timeTraceProfilerWrite(OS);
+    llvm::timeTraceProfilerCleanup();
+    Ctx.timeTrace = Trace.str().str();
+  }
+}
+
 } // namespace cxxlayout
 
 extern "C" {
@@ -232,6 +968,10 @@ void EMSCRIPTEN_KEEPALIVE cleanup() {
   auto &Ctx = cxxlayout::getContext();
   Ctx.recordList.clear();
   Ctx.records.clear();
+  Ctx.pathIndexes.clear();
+  Ctx.copySites.clear();
+  Ctx.indirectParams.clear();
+  Ctx.timeTrace.clear();
 }
 
 const char *EMSCRIPTEN_KEEPALIVE getRecordList() {
@@ -256,21 +996,198 @@ const char *EMSCRIPTEN_KEEPALIVE getRecordList() {
       Escaped = std::move(Tmp);
     }
     RecordList.append(Escaped);
-    RecordList.append("\"}");
+    RecordList.append("\"");
+    if (!R.second->file.empty()) {
+      std::string File;
+      llvm::raw_string_ostream OS(File);
+      writeEscaped(OS, R.second->file);
+      OS.flush();
+      RecordList.append(",\"file\":\"");
+      RecordList.append(File);
+      RecordList.append("\",\"line\":");
+      RecordList.append(llvm::utostr(R.second->line));
+    }
+    RecordList.append("}");
     first = false;
   }
   RecordList.append("]");
   return dupJson(RecordList);
 }
 
+// Runs a throwaway analysis so that what clang sets up lazily on first use
+// (driver option tables, diagnostic ids, target info) is ready before the
+// first real request. Meant to be called while the page is idle.
+void EMSCRIPTEN_KEEPALIVE warmUp() {
+  cxxlayout::analyzeCode("", "input.cpp");
+  cleanup();
+}
+
 void EMSCRIPTEN_KEEPALIVE analyzeSource(const char *source) {
+  StringRef Source(source);
+  cxxlayout::analyzeCode(Source, cxxlayout::isPreprocessedSource(Source)
+                                     ? "input.ii"
+                                     : "input.cpp");
+}
+
+// Raw Chrome trace event JSON of the last analysis, loadable in Perfetto or
+// chrome://tracing. "{}" if the analysis ran without -ftime-trace.
+const char *EMSCRIPTEN_KEEPALIVE getTimeTrace() {
   auto &Ctx = cxxlayout::getContext();
-  std::string localArgs;
-  Ctx.recordList.clear();
-  Ctx.records.clear();
-  localArgs = Ctx.args;
-  runToolOnCodeWithArgs(std::make_unique<Action>(), source,
-                        splitArgs(localArgs), "input.cpp");
+  return dupJson(Ctx.timeTrace.empty() ? "{}" : Ctx.timeTrace);
+}
+
+// Aggregates the trace of the last analysis into the headers and template
+// instantiations that took the most time. Header times are inclusive of the
+// headers they include.
+const char *EMSCRIPTEN_KEEPALIVE getTimeTraceSummary() {
+  auto &Ctx = cxxlayout::getContext();
+  llvm::Expected<llvm::json::Value> Trace = llvm::json::parse(Ctx.timeTrace);
+  if (!Trace) {
+    llvm::consumeError(Trace.takeError());
+    return dupJson("{}");
+  }
+
+  struct Entry {
+    std::string kind;
+    std::string name;
+    int64_t dur = 0;
+  };
+  llvm::StringMap<Entry> Headers, Instantiations;
+  int64_t Total = 0;
+  const llvm::json::Object *Root = Trace->getAsObject();
+  const llvm::json::Array *Events =
+      Root ? Root->getArray("traceEvents") : nullptr;
+  static const llvm::json::Array NoEvents;
+  for (const llvm::json::Value &V : Events ? *Events : NoEvents) {
+    const llvm::json::Object *E = V.getAsObject();
+    if (!E || E->getString("ph") != "X")
+      continue;
+    StringRef Name = E->getString("name").value_or("");
+    int64_t Dur = E->getInteger("dur").value_or(0);
+    StringRef Detail;
+    if (const llvm::json::Object *Args = E->getObject("args"))
+      Detail = Args->getString("detail").value_or("");
+    if (Name == "AnalyzeSource")
+      Total = std::max(Total, Dur);
+    llvm::StringMap<Entry> *Bucket = nullptr;
+    if (Name == "Source")
+      Bucket = &Headers;
+    else if (Name == "InstantiateClass" || Name == "InstantiateFunction")
+      Bucket = &Instantiations;
+    if (!Bucket || Detail.empty())
+      continue;
+    Entry &Ent = (*Bucket)[(Name + ":" + Detail).str()];
+    Ent.kind = Name.str();
+    Ent.name = Detail.str();
+    Ent.dur += Dur;
+  }
+
+  auto topEntries = [](const llvm::StringMap<Entry> &Map) {
+    std::vector<const Entry *> Sorted;
+    for (const auto &It : Map)
+      Sorted.push_back(&It.second);
+    llvm::sort(Sorted, [](const Entry *A, const Entry *B) {
+      return A->dur != B->dur ? A->dur > B->dur : A->name < B->name;
+    });
+    if (Sorted.size() > TIME_TRACE_SUMMARY_ENTRIES)
+      Sorted.resize(TIME_TRACE_SUMMARY_ENTRIES);
+    llvm::json::Array Out;
+    for (const Entry *Ent : Sorted)
+      Out.push_back(llvm::json::Object{
+          {"kind", Ent->kind}, {"name", Ent->name}, {"dur", Ent->dur}});
+    return Out;
+  };
+
+  std::string Json;
+  llvm::raw_string_ostream OS(Json);
+  OS << llvm::json::Value(llvm::json::Object{
+      {"total", Total},
+      {"headers", topEntries(Headers)},
+      {"instantiations", topEntries(Instantiations)},
+  });
+  OS.flush();
+  return dupJson(Json);
+}
+
+// Aggregate view of the records of the last analysis: total size and
+// padding, the records that are largest, waste the most bytes to padding
+// and are embedded (as field or base) in the most other records, and a
+// histogram of record sizes in power-of-two buckets.
+const char *EMSCRIPTEN_KEEPALIVE getSummary() {
+  auto &Ctx = cxxlayout::getContext();
+
+  struct Row {
+    int64_t id;
+    const cxxlayout::FieldInfo *info;
+    uint64_t size;
+    uint64_t padding;
+    uint64_t embedded = 0;
+  };
+  std::vector<Row> Rows;
+  Rows.reserve(Ctx.records.size());
+  llvm::StringMap<uint64_t> Embedded;
+  uint64_t TotalBytes = 0, PaddingBytes = 0;
+  std::vector<uint64_t> Histogram;
+  for (const auto &R : Ctx.records) {
+    const cxxlayout::FieldInfo &Info = *R.second;
+    uint64_t Size = Info.size.getQuantity();
+    Rows.push_back({R.first, &Info, Size, cxxlayout::getPaddingBytes(Info)});
+    TotalBytes += Size;
+    PaddingBytes += Rows.back().padding;
+    // Bucket I holds sizes in (2^(I-1), 2^I], bucket 0 sizes up to 1.
+    unsigned Bucket = Size <= 1 ? 0 : llvm::Log2_64_Ceil(Size);
+    if (Histogram.size() <= Bucket)
+      Histogram.resize(Bucket + 1);
+    ++Histogram[Bucket];
+    for (const auto &Sub : Info.subFields)
+      if (Sub && (Sub->fieldType == cxxlayout::FieldType::Record ||
+                  Sub->fieldType == cxxlayout::FieldType::NVBase))
+        ++Embedded[Sub->type];
+  }
+  for (Row &R : Rows)
+    R.embedded = Embedded.lookup(R.info->type);
+
+  auto topRows = [&](auto Key) {
+    std::vector<const Row *> Sorted;
+    for (const Row &R : Rows)
+      if (Key(R) != 0)
+        Sorted.push_back(&R);
+    llvm::sort(Sorted, [&](const Row *A, const Row *B) {
+      return Key(*A) != Key(*B) ? Key(*A) > Key(*B)
+                                : A->info->type < B->info->type;
+    });
+    if (Sorted.size() > LAYOUT_SUMMARY_ENTRIES)
+      Sorted.resize(LAYOUT_SUMMARY_ENTRIES);
+    llvm::json::Array Out;
+    for (const Row *R : Sorted)
+      Out.push_back(llvm::json::Object{
+          {"id", llvm::itostr(R->id)},
+          {"name", R->info->type},
+          {"size", static_cast<int64_t>(R->size)},
+          {"padding", static_cast<int64_t>(R->padding)},
+          {"embedded", static_cast<int64_t>(R->embedded)}});
+    return Out;
+  };
+
+  llvm::json::Array Buckets;
+  for (unsigned I = 0, E = Histogram.size(); I != E; ++I)
+    Buckets.push_back(llvm::json::Object{
+        {"max", static_cast<int64_t>(uint64_t(1) << I)},
+        {"count", static_cast<int64_t>(Histogram[I])}});
+
+  std::string Json;
+  llvm::raw_string_ostream OS(Json);
+  OS << llvm::json::Value(llvm::json::Object{
+      {"records", static_cast<int64_t>(Rows.size())},
+      {"totalBytes", static_cast<int64_t>(TotalBytes)},
+      {"paddingBytes", static_cast<int64_t>(PaddingBytes)},
+      {"largest", topRows([](const Row &R) { return R.size; })},
+      {"worstPadding", topRows([](const Row &R) { return R.padding; })},
+      {"mostEmbedded", topRows([](const Row &R) { return R.embedded; })},
+      {"histogram", std::move(Buckets)},
+  });
+  OS.flush();
+  return dupJson(Json);
 }
 
 const char *EMSCRIPTEN_KEEPALIVE getLayoutForRecord(int64_t id) {
@@ -284,54 +1201,171 @@ const char *EMSCRIPTEN_KEEPALIVE getLayoutForRecord(int64_t id) {
   std::string Json;
   llvm::raw_string_ostream OS(Json);
 
-  std::function<void(const cxxlayout::FieldInfo &, llvm::raw_ostream &,
-                     unsigned)>
-      writeField = [&](const cxxlayout::FieldInfo &F, llvm::raw_ostream &Out,
-                       unsigned Depth) {
-        Out << '{';
-        Out << "\"fieldType\":\"" << fieldTypeToString(F.fieldType) << "\"";
-        if (!F.name.empty()) {
-          Out << ',';
-          Out << "\"name\":\"";
-          writeEscaped(Out, F.name);
-          Out << "\"";
-        }
-        Out << ',';
-        Out << "\"type\":\"";
-        writeEscaped(Out, F.type);
-        Out << "\"";
-        Out << ',';
-        Out << "\"size\":" << F.size.getQuantity();
-        Out << ',';
-        Out << "\"align\":" << F.align.getQuantity();
-        Out << ',';
-        Out << "\"offset\":" << (F.offset >> 3);
-        if (F.fieldType == cxxlayout::FieldType::BitField) {
-          Out << ',';
-          Out << "\"bitWidth\":" << F.bitWidth;
-        }
-        if (F.fieldType == FieldType::Record ||
-            F.fieldType == FieldType::NVBase) {
-          Out << ',';
-          Out << "\"subFields\": [";
-          bool first = true;
-          for (const auto &SFptr : F.subFields) {
-            if (!SFptr)
-              continue;
-            if (!first)
-              Out << ',';
-            writeField(*SFptr, Out, Depth + 4);
-            first = false;
-          }
-          Out << ']';
-        }
-        Out << '}';
-      };
-  writeField(*Root, OS, 0);
+  writeFieldJson(OS, *Root);
   OS.flush();
   return dupJson(Json);
 }
 
+// Every record of the last analysis with its layout, in one call, for
+// callers that want all of them anyway.
+const char *EMSCRIPTEN_KEEPALIVE getAllLayouts() {
+  std::string Json;
+  llvm::raw_string_ostream OS(Json);
+  cxxlayout::writeRecordsJson(OS, cxxlayout::getContext());
+  OS.flush();
+  return dupJson(Json);
+}
+
+// Offset, size and type of a member path such as "hdr.lanes[3].flags" in a
+// record of the last analysis, or {"error"} if there is no such member.
+const char *EMSCRIPTEN_KEEPALIVE lookupPath(int64_t id, const char *path) {
+  auto &Ctx = cxxlayout::getContext();
+  auto It = Ctx.records.find(id);
+  if (It == Ctx.records.end())
+    return dupJson("{\"error\":\"no such record\"}");
+  auto Index = Ctx.pathIndexes.try_emplace(id, *It->second).first;
+
+  std::string Json;
+  llvm::raw_string_ostream OS(Json);
+  llvm::Expected<cxxlayout::FieldLocation> Location =
+      Index->second.lookup(path);
+  if (Location) {
+    cxxlayout::writeFieldLocationJson(OS, path, *Location);
+  } else {
+    OS << "{\"error\":\"";
+    cxxlayout::writeEscaped(OS, llvm::toString(Location.takeError()));
+    OS << "\"}";
+  }
+  OS.flush();
+  return dupJson(Json);
+}
+
+void EMSCRIPTEN_KEEPALIVE setRecordFilter(const char *filter) {
+  auto &Ctx = cxxlayout::getContext();
+  Ctx.recordFilter = filter ? filter : "";
+}
+
+// Returns 0 and keeps the current style if style isn't one of
+// parseTypeNameStyle's.
+int EMSCRIPTEN_KEEPALIVE setTypeNameStyle(const char *style) {
+  std::optional<cxxlayout::TypeNameStyle> Style =
+      cxxlayout::parseTypeNameStyle(style ? style : "");
+  if (!Style)
+    return 0;
+  cxxlayout::getContext().typeNameStyle = *Style;
+  return 1;
+}
+
+void EMSCRIPTEN_KEEPALIVE setAccessAnalysis(int enable) {
+  cxxlayout::getContext().analyzeAccesses = enable != 0;
+}
+
+// Copies of records of at least minSize bytes are found by the next
+// analyses, none if it is 0.
+void EMSCRIPTEN_KEEPALIVE setCopyAnalysis(int minSize) {
+  cxxlayout::getContext().copyMinSize = minSize > 0 ? minSize : 0;
+}
+
+// The copies the last analysis found, ranked by estimated bytes copied:
+// [{"file", "line", "column", "kind", "type", "size", "loopDepth", "bytes",
+//   "fix"}, ...]
+const char *EMSCRIPTEN_KEEPALIVE getCopySites() {
+  std::string Json;
+  llvm::raw_string_ostream OS(Json);
+  cxxlayout::writeCopySitesJson(OS, cxxlayout::getContext().copySites);
+  OS.flush();
+  return dupJson(Json);
+}
+
+// Returns {} or {"error"}, if the build has no calling convention
+// classification (see CXXLAYOUT_CALLING_CONV) or a target description is
+// set. The data layout clang lowers calls with doesn't follow the sizes and
+// alignments a description changes.
+const char *EMSCRIPTEN_KEEPALIVE setAbiClassification(int enable) {
+#ifdef CXXLAYOUT_CALLING_CONV
+  auto &Ctx = cxxlayout::getContext();
+  if (enable && Ctx.targetDescription)
+    return dupJson("{\"error\":\"calling convention classification can't "
+                   "be combined with a target description\"}");
+  Ctx.classifyAbi = enable != 0;
+  return dupJson("{}");
+#else
+  if (!enable)
+    return dupJson("{}");
+  return dupJson("{\"error\":\"this build has no calling convention "
+                 "classification\"}");
+#endif
+}
+
+// The parameters that take records in memory by value, found by the last
+// analysis: [{"function", "file", "line", "index", "name", "type", "size"},
+// ...]
+const char *EMSCRIPTEN_KEEPALIVE getIndirectParams() {
+  std::string Json;
+  llvm::raw_string_ostream OS(Json);
+  cxxlayout::writeIndirectParamsJson(OS,
+                                     cxxlayout::getContext().indirectParams);
+  OS.flush();
+  return dupJson(Json);
+}
+
+void EMSCRIPTEN_KEEPALIVE setHeaderPruning(int enable) {
+  auto &Ctx = cxxlayout::getContext();
+  Ctx.pruneHeaders = enable != 0;
+  Ctx.pruneKey.clear();
+  Ctx.unprunableKey.clear();
+  Ctx.prunedIncludes.clear();
+  Ctx.prunedDirectives.clear();
+}
+
+// Headers the last analysis was (or will next be) restricted to, in include
+// order.
+const char *EMSCRIPTEN_KEEPALIVE getPrunedIncludes() {
+  auto &Ctx = cxxlayout::getContext();
+  std::string Json;
+  llvm::raw_string_ostream OS(Json);
+  OS << '[';
+  bool first = true;
+  for (const std::string &Include : Ctx.prunedIncludes) {
+    if (!first)
+      OS << ',';
+    OS << '"';
+    writeEscaped(OS, Include);
+    OS << '"';
+    first = false;
+  }
+  OS << ']';
+  OS.flush();
+  return dupJson(Json);
+}
+
+// Sets the data model overrides of TargetDescription, or clears them if
+// json is empty. Returns {} or {"error"}, keeping the previous description
+// on error.
+const char *EMSCRIPTEN_KEEPALIVE setTargetDescription(const char *json) {
+  auto &Ctx = cxxlayout::getContext();
+  if (!json || !json[0]) {
+    Ctx.targetDescription.reset();
+    return dupJson("{}");
+  }
+  if (Ctx.classifyAbi)
+    return dupJson("{\"error\":\"a target description can't be combined "
+                   "with calling convention classification\"}");
+  llvm::Expected<cxxlayout::TargetDescription> Description =
+      cxxlayout::TargetDescription::parse(json);
+  if (!Description) {
+    std::string Json;
+    llvm::raw_string_ostream OS(Json);
+    OS << "{\"error\":\"";
+    cxxlayout::writeEscaped(OS, llvm::toString(Description.takeError()));
+    OS << "\"}";
+    OS.flush();
+    return dupJson(Json);
+  }
+  Ctx.targetDescription = std::move(*Description);
+  return dupJson("{}");
+}
+
 void EMSCRIPTEN_KEEPALIVE setArgs(const char *newArgs) {
   auto &Ctx = cxxlayout::getContext();
   if (newArgs && newArgs[0])
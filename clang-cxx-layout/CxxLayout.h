@@ -1,7 +1,24 @@
+#ifndef CXXLAYOUT_CXXLAYOUT_H
+#define CXXLAYOUT_CXXLAYOUT_H
+
+#include "TargetDescription.h"
+
 #include "clang/AST/CharUnits.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace cxxlayout {
 
@@ -34,6 +51,29 @@ inline constexpr std::string_view fieldTypeToString(FieldType ft) {
 class FieldInfo;
 using FieldInfoPtr = std::unique_ptr<FieldInfo>;
 
+// How a record is passed and returned by value in the target's C ABI, see
+// AbiClassifier.
+struct AbiClass {
+  std::string pass;      // clang's lowering: direct, indirect, expand, ...
+  bool inMemory = false; // passed on the stack or through a pointer
+  bool sret = false;     // returned through a hidden pointer argument
+  std::string coerceTo;  // the LLVM type it is passed as, if in registers
+  // The classes of its eightbytes on x86-64 SysV: INTEGER, SSE or X87, or
+  // just MEMORY.
+  std::vector<std::string> classes;
+  // HFA or HVA on AArch64 and ARM, with the number of members.
+  std::string homogeneous;
+  unsigned members = 0;
+};
+
+// Two fields of a record that are accessed together, see
+// FieldAccessCollector.
+struct FieldAffinity {
+  std::string first;
+  std::string second;
+  uint64_t weight;
+};
+
 class FieldInfo {
 public:
   bool isValid;
@@ -43,8 +83,240 @@ public:
   uint64_t offset; // in bits
   clang::CharUnits size;
   clang::CharUnits align;
+  // For data members other than bitfields: the alignment the member is laid
+  // out with, which packing and alignas can make differ from the type's.
+  clang::CharUnits fieldAlign;
   uint64_t bitWidth; // for bitfields
   llvm::SmallVector<FieldInfoPtr> subFields;
+  std::string file;  // presumed location, top-level records only
+  unsigned line = 0;
+  // Fully qualified name usable in generated code, top-level records only.
+  // Empty if the record can't be named from outside its scope.
+  std::string spelling;
+  bool isPublic = true;          // for data members
+  bool hasVirtualBases = false;  // for records
+  // [[clang::annotate("layout:...")]] annotations, without the prefix.
+  std::vector<std::string> annotations;
+  // Byte range of the field's declaration in the analyzed source, if it is
+  // spelled there without macros.
+  std::optional<std::pair<unsigned, unsigned>> declRange;
+  // For constant size arrays: the size of each dimension, outermost first,
+  // and the type of the innermost elements, with its layout if it is a
+  // record.
+  llvm::SmallVector<uint64_t, 1> arrayDims;
+  std::string elementType;
+  clang::CharUnits elementSize;
+  FieldInfoPtr element;
+  // Static access estimate, if enabled: the weighted number of accesses of a
+  // field of a top-level record, and for the record the fields most often
+  // used together and a proposed order of its fields with the size it
+  // would give.
+  uint64_t accesses = 0;
+  std::vector<FieldAffinity> affinities;
+  std::vector<std::string> proposedOrder;
+  clang::CharUnits proposedSize;
+  // For top-level records, if calling convention classification is on.
+  std::optional<AbiClass> abi;
+};
+
+// A copy of a record in a function body, see findCopies.
+struct CopySite {
+  std::string file; // presumed location
+  unsigned line = 0;
+  unsigned column = 0;
+  std::string kind; // range-for, capture, argument, initialization, ...
+  std::string type; // qualified name of the record
+  uint64_t size = 0;  // in bytes
+  unsigned loopDepth = 0;
+  uint64_t bytes = 0; // estimated bytes copied: size weighted by loops
+  std::string fix;
+};
+
+// A parameter that takes a record passed in memory by value.
+struct IndirectParam {
+  std::string function; // qualified name
+  std::string file;     // presumed location of the parameter
+  unsigned line = 0;
+  unsigned index = 0;
+  std::string name;
+  std::string type;
+  uint64_t size = 0; // in bytes
+};
+
+// Where a member path such as "hdr.lanes[3].flags" is in a record.
+struct FieldLocation {
+  FieldType fieldType;
+  std::string type;
+  uint64_t offset;   // in bits
+  uint64_t size;     // in bytes
+  uint64_t bitWidth; // for bitfields
 };
 
+// Resolves member paths of a record without walking its fields. Every path
+// is indexed with its array subscripts left out ("hdr.lanes[].flags"), along
+// with the stride of each subscript, so a lookup is one hash lookup plus a
+// multiply-add per subscript. Members of bases and of anonymous structs and
+// unions are found by their own names, as in C++.
+class FieldPathIndex {
+  struct Subscript {
+    uint64_t bound;
+    uint64_t stride; // in bits
+  };
+  struct Entry {
+    FieldType fieldType;
+    std::string type;
+    uint64_t offset; // in bits, with all subscripts 0
+    uint64_t size;
+    uint64_t bitWidth;
+    llvm::SmallVector<Subscript, 1> subscripts;
+  };
+  llvm::StringMap<Entry> Entries;
+
+  void addMembers(const FieldInfo &Record, llvm::StringRef Prefix,
+                  uint64_t Offset, llvm::ArrayRef<Subscript> Subscripts);
+  void addField(const FieldInfo &Field, std::string Path, uint64_t Offset,
+                llvm::ArrayRef<Subscript> Subscripts);
+
+public:
+  explicit FieldPathIndex(const FieldInfo &Record);
+
+  // Path is member names separated by '.', each optionally followed by
+  // [N] subscripts.
+  llvm::Expected<FieldLocation> lookup(llvm::StringRef Path) const;
+};
+
+// How the types of fields are printed. Names of records are always
+// qualified, since records are looked up by them.
+enum class TypeNameStyle : uint8_t {
+  Full,    // every template argument, including defaulted ones
+  Default, // template arguments equal to their defaults left out
+  Short,   // also without namespace and class qualifiers
+};
+
+// "full", "default" or "short".
+std::optional<TypeNameStyle> parseTypeNameStyle(llvm::StringRef Name);
+
+inline const std::string DEFAULT_ARGS = "--target=x86_64-pc-linux-gnu";
+
+struct LayoutContext {
+  std::string args = DEFAULT_ARGS;
+  // Applied on top of the target the args select.
+  std::optional<TargetDescription> targetDescription;
+  std::string recordList;
+  std::map<int64_t, FieldInfoPtr> records;
+  std::string timeTrace; // Chrome trace JSON of the last analysis, if enabled
+  std::string recordFilter; // regex on qualified names, empty matches all
+  TypeNameStyle typeNameStyle = TypeNameStyle::Default;
+  // Run FieldAccessCollector over the function bodies. Turns off header
+  // pruning, which drops the bodies in unneeded headers.
+  bool analyzeAccesses = false;
+  // Look for copies of records of at least this many bytes, if non-zero,
+  // into copySites. Turns off header pruning like analyzeAccesses.
+  uint64_t copyMinSize = 0;
+  std::vector<CopySite> copySites;
+  // Classify how records are passed by value, into FieldInfo::abi and
+  // indirectParams. Only in builds with CXXLAYOUT_CALLING_CONV, and not
+  // with a target description.
+  bool classifyAbi = false;
+  std::vector<IndirectParam> indirectParams;
+  // Printed names of the types and decls of the current translation unit,
+  // which nested records print over and over. Keyed by QualType and Decl
+  // pointers, so they don't outlive the ASTContext.
+  llvm::DenseMap<const void *, std::string> typeNames;
+  llvm::DenseMap<const void *, std::string> declNames;
+
+  // Header pruning: the first analysis records which headers the matching
+  // records depend on, later ones with the same args, filter and #include
+  // directives only parse those.
+  bool pruneHeaders = false;
+  bool collectHeaderDeps = false;
+  std::string pruneKey;
+  std::vector<std::string> prunedIncludes;
+  // Which of the source's #include lines the full run processed, see
+  // getProcessedIncludes. Only those are blanked in the pruned source.
+  std::vector<bool> prunedDirectives;
+  // Set when the pruned run for this key failed with the include set the
+  // full run computes anyway, so there is no point in pruning it.
+  std::string unprunableKey;
+  // Where the analyzed source starts in the main file buffer, non-zero when
+  // a pruned include prefix was put in front of it.
+  unsigned sourceOffset = 0;
+  std::string targetTriple; // target of the last analysis
+  // Whether the last analysis had compile errors, which can leave records
+  // out or lay them out wrongly.
+  bool hasErrors = false;
+  // Files the last analysis read besides the main file, as clang found them.
+  std::vector<std::string> includedFiles;
+  // If set, every record is passed to this as soon as it is analyzed instead
+  // of being kept in records, so that callers writing records out as they
+  // come don't hold those of a whole translation unit. Not meant for pruned
+  // analyses, which may be discarded and run again.
+  std::function<void(int64_t Id, const FieldInfo &Record)> recordSink;
+  // Built on the first lookupPath of a record.
+  std::map<int64_t, FieldPathIndex> pathIndexes;
+};
+
+LayoutContext &getContext();
+
+// Analyzes Code as the file FileName with the current arguments, replacing
+// the records of the previous analysis. .i/.ii files are taken as
+// preprocessed C++.
+void analyzeCode(llvm::StringRef Code, llvm::StringRef FileName);
+
+// Whether Source looks like preprocessor output with line markers.
+bool isPreprocessedSource(llvm::StringRef Source);
+
+// The byte ranges [begin, end) of Record that hold data, sorted and with
+// adjacent and overlapping (union) ranges merged. Bitfields cover the bytes
+// their bits are in. The vptr only counts as data if IncludeVPtr is set.
+std::vector<std::pair<uint64_t, uint64_t>>
+getDataRanges(const FieldInfo &Record, bool IncludeVPtr);
+
+// Bytes of Record, including tail padding, that are neither data nor vptr.
+uint64_t getPaddingBytes(const FieldInfo &Record);
+
+void writeEscaped(llvm::raw_ostream &OS, llvm::StringRef S);
+void writeFieldJson(llvm::raw_ostream &OS, const FieldInfo &F);
+// {"id", "name", "file", "line", "layout"} of a record.
+void writeRecordJson(llvm::raw_ostream &OS, int64_t Id,
+                     const FieldInfo &Record);
+// {"pass", "inMemory", "sret", "coerceTo", "classes", "homogeneous",
+//  "members"}, leaving out what doesn't apply.
+void writeAbiJson(llvm::raw_ostream &OS, const AbiClass &Abi);
+void writeIndirectParamsJson(llvm::raw_ostream &OS,
+                             const std::vector<IndirectParam> &Params);
+// An array of writeRecordJson of every record in Ctx. Natively the records
+// are serialized in parallel, on llvm::parallel::strategy's threads.
+void writeRecordsJson(llvm::raw_ostream &OS, const LayoutContext &Ctx);
+// {"path", "fieldType", "type", "offset", "size", "bitOffset", "bitWidth"},
+// with offset in bytes and bitOffset in bits.
+void writeFieldLocationJson(llvm::raw_ostream &OS, llvm::StringRef Path,
+                            const FieldLocation &Location);
+
 } // namespace cxxlayout
+
+extern "C" {
+void cleanup();
+const char *getRecordList();
+void warmUp();
+void analyzeSource(const char *source);
+const char *getTimeTrace();
+const char *getTimeTraceSummary();
+const char *getSummary();
+const char *getLayoutForRecord(int64_t id);
+const char *getAllLayouts();
+const char *lookupPath(int64_t id, const char *path);
+void setRecordFilter(const char *filter);
+int setTypeNameStyle(const char *style);
+void setAccessAnalysis(int enable);
+void setCopyAnalysis(int minSize);
+const char *getCopySites();
+const char *setAbiClassification(int enable);
+const char *getIndirectParams();
+void setHeaderPruning(int enable);
+const char *getPrunedIncludes();
+const char *setTargetDescription(const char *json);
+void setArgs(const char *newArgs);
+}
+
+#endif // CXXLAYOUT_CXXLAYOUT_H
@@ -0,0 +1,575 @@
+// Command line front end of the native build. The wasm build is driven
+// through the exported C functions instead.
+
+#ifndef __EMSCRIPTEN__
+
+#include "CopyDetector.h"
+#include "CxxLayout.h"
+#include "Generators.h"
+#include "LayoutLint.h"
+#include "RevisionDiff.h"
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+using namespace llvm;
+
+static cl::OptionCategory LayoutCategory("clang-cxx-layout options");
+
+static cl::list<std::string> InputFiles(cl::Positional,
+                                        cl::desc("<input files>"),
+                                        cl::OneOrMore, cl::cat(LayoutCategory));
+
+static cl::opt<std::string>
+    CompilerArgs("args",
+                 cl::desc("Space separated arguments passed to clang "
+                          "(default: --target=x86_64-pc-linux-gnu)"),
+                 cl::value_desc("args"), cl::cat(LayoutCategory));
+
+static cl::opt<std::string>
+    RecordFilter("filter",
+                 cl::desc("Only analyze records whose qualified name matches "
+                          "this regex"),
+                 cl::value_desc("regex"), cl::cat(LayoutCategory));
+
+static cl::opt<bool> AccessAffinity(
+    "access-affinity",
+    cl::desc("Estimate from the function bodies how often each field is "
+             "accessed and which fields are accessed together, and propose "
+             "a field order that keeps those on the same cache lines"),
+    cl::cat(LayoutCategory));
+
+static cl::opt<bool>
+    Copies("copies",
+           cl::desc("Print the copies of large records in function bodies, "
+                    "ranked by estimated bytes copied, with suggested fixes "
+                    "as JSON instead of the layouts"),
+           cl::cat(LayoutCategory));
+
+static cl::opt<unsigned>
+    CopyMinSize("copy-min-size",
+                cl::desc("Smallest record size --copies reports copies of"),
+                cl::init(64), cl::value_desc("bytes"),
+                cl::cat(LayoutCategory));
+
+#ifdef CXXLAYOUT_CALLING_CONV
+static cl::opt<bool>
+    Abi("abi",
+        cl::desc("Classify how the target passes and returns each record by "
+                 "value, and list the parameters that take records in "
+                 "memory"),
+        cl::cat(LayoutCategory));
+#endif
+
+static cl::opt<unsigned>
+    Threads("threads",
+            cl::desc("Number of threads serializing records (default: one "
+                     "per core)"),
+            cl::value_desc("n"), cl::cat(LayoutCategory));
+
+static cl::opt<cxxlayout::TypeNameStyle> TypeNames(
+    "type-names", cl::desc("How the types of fields are printed"),
+    cl::values(clEnumValN(cxxlayout::TypeNameStyle::Full, "full",
+                          "With all template arguments"),
+               clEnumValN(cxxlayout::TypeNameStyle::Default, "default",
+                          "Without defaulted template arguments"),
+               clEnumValN(cxxlayout::TypeNameStyle::Short, "short",
+                          "Also without namespace and class qualifiers")),
+    cl::init(cxxlayout::TypeNameStyle::Default), cl::cat(LayoutCategory));
+
+static cl::opt<std::string> TargetDescriptionFile(
+    "target-description",
+    cl::desc("JSON file of type widths, alignments and bitfield rules that "
+             "override the data model of the target"),
+    cl::value_desc("file"), cl::cat(LayoutCategory));
+
+static cl::opt<bool>
+    NDJson("ndjson",
+           cl::desc("Print a line of run metadata, then one line per record "
+                    "as soon as it is analyzed, instead of one JSON document"),
+           cl::cat(LayoutCategory));
+
+static cl::list<std::string>
+    LookupPaths("lookup",
+                cl::desc("Print the offset, size and type of a member of an "
+                         "analyzed record as JSON instead of the layouts, "
+                         "e.g. 'ns::Packet.hdr.lanes[3].flags'"),
+                cl::value_desc("record.path"), cl::cat(LayoutCategory));
+
+static cl::opt<std::string>
+    LockHeader("lock-header",
+               cl::desc("Write static_assert checks of the size, alignment "
+                        "and field offsets of the analyzed records to this "
+                        "header instead of printing JSON ('-' for stdout)"),
+               cl::value_desc("file"), cl::cat(LayoutCategory));
+
+static cl::list<std::string>
+    LockTargets("lock-targets",
+                cl::desc("Target triples to lock layouts for, each in its "
+                         "own guarded block (default: the target of --args)"),
+                cl::CommaSeparated, cl::value_desc("triple,..."),
+                cl::cat(LayoutCategory));
+
+static cl::opt<std::string> ReflectionHeader(
+    "reflection-header",
+    cl::desc("Write constexpr tables of the fields and padding-free byte "
+             "runs of the analyzed records to this header instead of "
+             "printing JSON ('-' for stdout)"),
+    cl::value_desc("file"), cl::cat(LayoutCategory));
+
+static cl::opt<bool>
+    Lint("lint",
+         cl::desc("Check the analyzed records against their layout budgets "
+                  "and print the violations as JSON instead of the layouts. "
+                  "Exits with 1 if there are any"),
+         cl::cat(LayoutCategory));
+
+static cl::opt<std::string>
+    LintConfig("lint-config",
+               cl::desc("JSON file of layout budgets for --lint, in addition "
+                        "to [[clang::annotate(\"layout:...\")]] in source"),
+               cl::value_desc("file"), cl::cat(LayoutCategory));
+
+static cl::opt<std::string> DiffRevisions(
+    "diff",
+    cl::desc("Analyze the input files at two git revisions and print how "
+             "their records changed as JSON. The head defaults to HEAD"),
+    cl::value_desc("base[..head]"), cl::cat(LayoutCategory));
+
+static cl::opt<std::string>
+    CacheDir("cache-dir",
+             cl::desc("Where --diff caches analysis results, empty to "
+                      "disable the cache"),
+             cl::init(".cxx-layout/cache"), cl::value_desc("dir"),
+             cl::cat(LayoutCategory));
+
+static cl::opt<std::string>
+    HistoryFile("history",
+                cl::desc("NDJSON file --diff appends the record sizes of "
+                         "both revisions to, empty to disable"),
+                cl::init(".cxx-layout/history.ndjson"), cl::value_desc("file"),
+                cl::cat(LayoutCategory));
+
+// Args with any target option replaced by --target=Triple.
+static std::string withTarget(StringRef Args, StringRef Triple) {
+  SmallVector<StringRef> Parts;
+  Args.split(Parts, ' ', -1, /*KeepEmpty=*/false);
+  std::vector<StringRef> Kept;
+  for (unsigned I = 0, E = Parts.size(); I != E; ++I) {
+    if (Parts[I] == "-target" || Parts[I] == "--target")
+      ++I; // and its value
+    else if (!Parts[I].starts_with("--target="))
+      Kept.push_back(Parts[I]);
+  }
+  std::string Result = llvm::join(Kept, " ");
+  if (!Result.empty())
+    Result.push_back(' ');
+  return Result + "--target=" + Triple.str();
+}
+
+using InputList =
+    std::vector<std::pair<std::string, std::unique_ptr<MemoryBuffer>>>;
+
+static int writeOutput(StringRef Path,
+                       function_ref<void(raw_ostream &)> Write,
+                       const char *Argv0) {
+  std::error_code EC;
+  ToolOutputFile Out(Path, EC, sys::fs::OF_Text);
+  if (EC) {
+    WithColor::error(errs(), Argv0) << Path << ": " << EC.message() << '\n';
+    return 1;
+  }
+  Write(Out.os());
+  Out.keep();
+  return 0;
+}
+
+static int writeLockHeader(const InputList &Inputs, const char *Argv0) {
+  auto &Ctx = cxxlayout::getContext();
+  std::vector<std::string> Targets(LockTargets.begin(), LockTargets.end());
+  if (Targets.empty())
+    Targets.emplace_back();
+  std::string BaseArgs = Ctx.args;
+  cxxlayout::LayoutLockWriter Writer;
+  for (const std::string &Target : Targets) {
+    if (!Target.empty())
+      Ctx.args = withTarget(BaseArgs, Target);
+    for (const auto &[File, Buffer] : Inputs) {
+      cxxlayout::analyzeCode(Buffer->getBuffer(), File);
+      if (Error E = Writer.addRecords(Ctx)) {
+        WithColor::error(errs(), Argv0) << toString(std::move(E)) << '\n';
+        return 1;
+      }
+    }
+  }
+
+  return writeOutput(
+      LockHeader, [&](raw_ostream &OS) { Writer.write(OS); }, Argv0);
+}
+
+static int writeReflectionHeader(const InputList &Inputs, const char *Argv0) {
+  auto &Ctx = cxxlayout::getContext();
+  cxxlayout::ReflectionTableWriter Writer;
+  for (const auto &[File, Buffer] : Inputs) {
+    cxxlayout::analyzeCode(Buffer->getBuffer(), File);
+    if (Error E = Writer.addRecords(Ctx)) {
+      WithColor::error(errs(), Argv0) << toString(std::move(E)) << '\n';
+      return 1;
+    }
+  }
+  return writeOutput(
+      ReflectionHeader, [&](raw_ostream &OS) { Writer.write(OS); }, Argv0);
+}
+
+static int lintRecords(const InputList &Inputs, const char *Argv0) {
+  cxxlayout::LayoutLinter Linter;
+  if (!LintConfig.empty()) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Config =
+        MemoryBuffer::getFile(LintConfig);
+    if (!Config) {
+      WithColor::error(errs(), Argv0)
+          << LintConfig << ": " << Config.getError().message() << '\n';
+      return 1;
+    }
+    Expected<cxxlayout::LayoutLinter> Parsed =
+        cxxlayout::LayoutLinter::fromConfig((*Config)->getBuffer());
+    if (!Parsed) {
+      WithColor::error(errs(), Argv0)
+          << LintConfig << ": " << toString(Parsed.takeError()) << '\n';
+      return 1;
+    }
+    Linter = std::move(*Parsed);
+  }
+
+  auto &Ctx = cxxlayout::getContext();
+  std::vector<cxxlayout::LintViolation> Violations;
+  StringSet<> Checked; // records of headers shared by several inputs
+  int Status = 0;
+  for (const auto &[File, Buffer] : Inputs) {
+    cxxlayout::analyzeCode(Buffer->getBuffer(), File);
+    for (const auto &R : Ctx.records) {
+      const cxxlayout::FieldInfo &Info = *R.second;
+      if (!Checked.insert(Info.file + ":" + utostr(Info.line) + ":" + Info.type)
+               .second)
+        continue;
+      if (Error E = Linter.check(Info, Violations)) {
+        WithColor::error(errs(), Argv0) << toString(std::move(E)) << '\n';
+        Status = 1;
+      }
+    }
+  }
+  cxxlayout::writeViolationsJson(outs(), Violations);
+  outs() << '\n';
+  return Violations.empty() ? Status : 1;
+}
+
+static int diffRevisions(const char *Argv0) {
+  auto [BaseRev, HeadRev] = StringRef(DiffRevisions).split("..");
+  if (HeadRev.empty())
+    HeadRev = "HEAD";
+  // The revisions are analyzed from within their worktrees.
+  std::optional<cxxlayout::AnalysisCache> Cache;
+  if (!CacheDir.empty()) {
+    SmallString<128> Dir(CacheDir);
+    sys::fs::make_absolute(Dir);
+    Cache.emplace(Dir);
+  }
+  std::vector<std::string> Files(InputFiles.begin(), InputFiles.end());
+
+  StringRef Revisions[] = {BaseRev, HeadRev};
+  std::optional<cxxlayout::RevisionLayouts> Layouts[2];
+  for (unsigned I = 0; I != 2; ++I) {
+    Expected<cxxlayout::RevisionLayouts> Result = cxxlayout::analyzeRevision(
+        Revisions[I], Files, Cache ? &*Cache : nullptr);
+    if (!Result) {
+      WithColor::error(errs(), Argv0) << toString(Result.takeError()) << '\n';
+      return 1;
+    }
+    Layouts[I] = std::move(*Result);
+  }
+
+  if (!HistoryFile.empty()) {
+    for (const auto &Revision : Layouts) {
+      if (Error E = cxxlayout::appendHistory(HistoryFile, *Revision)) {
+        WithColor::warning(errs(), Argv0) << toString(std::move(E)) << '\n';
+        break;
+      }
+    }
+  }
+  outs() << cxxlayout::diffLayouts(*Layouts[0], *Layouts[1]) << '\n';
+  return 0;
+}
+
+static void writeRecords(raw_ostream &OS, StringRef File) {
+  auto &Ctx = cxxlayout::getContext();
+  OS << "{\"file\":\"";
+  cxxlayout::writeEscaped(OS, File);
+  OS << "\",\"records\":";
+  cxxlayout::writeRecordsJson(OS, Ctx);
+  if (Ctx.classifyAbi) {
+    OS << ",\"indirectParams\":";
+    cxxlayout::writeIndirectParamsJson(OS, Ctx.indirectParams);
+  }
+  OS << '}';
+}
+
+// Reads and analyzes the inputs one at a time, writing out each record as
+// its analysis finishes, so that output of any size is produced in constant
+// memory:
+//   {"type":"run","args":...,"filter":...,"inputs":[...]}
+//   {"type":"record","input":"a.cpp","record":{"id",...,"layout"}}
+// With --abi, each input is followed by
+//   {"type":"indirectParams","input":"a.cpp","params":[...]}
+static int streamRecords(const char *Argv0) {
+  auto &Ctx = cxxlayout::getContext();
+  json::Array InputArray;
+  for (const std::string &File : InputFiles)
+    InputArray.push_back(File);
+  outs() << json::Value(json::Object{{"type", "run"},
+                                     {"args", Ctx.args},
+                                     {"filter", Ctx.recordFilter},
+                                     {"inputs", std::move(InputArray)}})
+         << '\n';
+  outs().flush();
+
+  int Status = 0;
+  StringRef Input;
+  Ctx.recordSink = [&](int64_t Id, const cxxlayout::FieldInfo &Record) {
+    outs() << "{\"type\":\"record\",\"input\":\"";
+    cxxlayout::writeEscaped(outs(), Input);
+    outs() << "\",\"record\":";
+    cxxlayout::writeRecordJson(outs(), Id, Record);
+    outs() << "}\n";
+    outs().flush();
+  };
+  for (const std::string &File : InputFiles) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(File);
+    if (!Buffer) {
+      WithColor::error(errs(), Argv0)
+          << File << ": " << Buffer.getError().message() << '\n';
+      Status = 1;
+      continue;
+    }
+    Input = File;
+    cxxlayout::analyzeCode((*Buffer)->getBuffer(), File);
+    if (Ctx.classifyAbi) {
+      outs() << "{\"type\":\"indirectParams\",\"input\":\"";
+      cxxlayout::writeEscaped(outs(), Input);
+      outs() << "\",\"params\":";
+      cxxlayout::writeIndirectParamsJson(outs(), Ctx.indirectParams);
+      outs() << "}\n";
+      outs().flush();
+    }
+  }
+  Ctx.recordSink = nullptr;
+  return Status;
+}
+
+// Splits "ns::Rec<a.b>.x.y" into the record name and the member path.
+static std::pair<StringRef, StringRef> splitRecordPath(StringRef Spec) {
+  int Depth = 0;
+  for (size_t I = 0, E = Spec.size(); I != E; ++I) {
+    if (Spec[I] == '<')
+      ++Depth;
+    else if (Spec[I] == '>')
+      --Depth;
+    else if (Spec[I] == '.' && Depth == 0)
+      return {Spec.take_front(I), Spec.drop_front(I + 1)};
+  }
+  return {Spec, ""};
+}
+
+static int lookupPaths(const InputList &Inputs, const char *Argv0) {
+  auto &Ctx = cxxlayout::getContext();
+  int Status = 0;
+  StringSet<> Found; // once, even if the record is in several inputs
+  bool First = true;
+  outs() << '[';
+  for (const auto &[File, Buffer] : Inputs) {
+    cxxlayout::analyzeCode(Buffer->getBuffer(), File);
+    for (const std::string &Spec : LookupPaths) {
+      if (Found.contains(Spec))
+        continue;
+      auto [Name, Path] = splitRecordPath(Spec);
+      auto It = llvm::find_if(Ctx.records, [&](const auto &R) {
+        return R.second->type == Name;
+      });
+      if (It == Ctx.records.end())
+        continue;
+      Found.insert(Spec);
+      const cxxlayout::FieldPathIndex &Index =
+          Ctx.pathIndexes.try_emplace(It->first, *It->second).first->second;
+      Expected<cxxlayout::FieldLocation> Location = Index.lookup(Path);
+      if (!Location) {
+        WithColor::error(errs(), Argv0)
+            << Name << ": " << toString(Location.takeError()) << '\n';
+        Status = 1;
+        continue;
+      }
+      if (!First)
+        outs() << ',';
+      cxxlayout::writeFieldLocationJson(outs(), Spec, *Location);
+      First = false;
+    }
+  }
+  outs() << "]\n";
+  for (const std::string &Spec : LookupPaths) {
+    if (!Found.contains(Spec)) {
+      WithColor::error(errs(), Argv0)
+          << "no record " << splitRecordPath(Spec).first << '\n';
+      Status = 1;
+    }
+  }
+  return Status;
+}
+
+// Copies in headers shared by several inputs are reported once.
+static int reportCopies(const InputList &Inputs) {
+  auto &Ctx = cxxlayout::getContext();
+  Ctx.copyMinSize = std::max<unsigned>(CopyMinSize, 1);
+  std::vector<cxxlayout::CopySite> Sites;
+  StringSet<> Seen;
+  for (const auto &[File, Buffer] : Inputs) {
+    cxxlayout::analyzeCode(Buffer->getBuffer(), File);
+    for (cxxlayout::CopySite &Site : Ctx.copySites)
+      if (Seen.insert(Site.file + ":" + utostr(Site.line) + ":" +
+                      utostr(Site.column) + ":" + Site.kind)
+              .second)
+        Sites.push_back(std::move(Site));
+  }
+  cxxlayout::rankCopySites(Sites);
+  cxxlayout::writeCopySitesJson(outs(), Sites);
+  outs() << '\n';
+  return 0;
+}
+
+int main(int argc, const char **argv) {
+  InitLLVM X(argc, argv);
+  cl::HideUnrelatedOptions(LayoutCategory);
+  cl::ParseCommandLineOptions(
+      argc, argv,
+      "Computes the memory layout of the C++ records in each input file.\n"
+      "Preprocessed .i/.ii files are analyzed without header search.\n");
+
+  // Each mode prints a document of its own instead of the layouts, except
+  // that the lock and reflection headers can be written in one run.
+  SmallVector<const char *> Modes;
+  if (!DiffRevisions.empty())
+    Modes.push_back("--diff");
+  if (NDJson)
+    Modes.push_back("--ndjson");
+  if (Lint || !LintConfig.empty())
+    Modes.push_back(Lint ? "--lint" : "--lint-config");
+  if (!LookupPaths.empty())
+    Modes.push_back("--lookup");
+  if (Copies)
+    Modes.push_back("--copies");
+  if (!LockHeader.empty() || !ReflectionHeader.empty())
+    Modes.push_back(!LockHeader.empty() ? "--lock-header"
+                                        : "--reflection-header");
+  if (Modes.size() > 1) {
+    WithColor::error(errs(), argv[0])
+        << Modes[0] << " can't be combined with " << Modes[1] << '\n';
+    return 1;
+  }
+
+  if (Threads)
+    parallel::strategy = hardware_concurrency(Threads);
+
+  auto &Ctx = cxxlayout::getContext();
+  if (!CompilerArgs.empty())
+    Ctx.args = CompilerArgs;
+  Ctx.recordFilter = RecordFilter;
+  Ctx.typeNameStyle = TypeNames;
+  Ctx.analyzeAccesses = AccessAffinity;
+#ifdef CXXLAYOUT_CALLING_CONV
+  // Clang lowers calls with the target's data layout, which a description
+  // doesn't change.
+  if (Abi && !TargetDescriptionFile.empty()) {
+    WithColor::error(errs(), argv[0])
+        << "--abi can't be combined with --target-description\n";
+    return 1;
+  }
+  Ctx.classifyAbi = Abi;
+#endif
+  if (!TargetDescriptionFile.empty()) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(TargetDescriptionFile);
+    if (!Buffer) {
+      WithColor::error(errs(), argv[0]) << TargetDescriptionFile << ": "
+                                        << Buffer.getError().message() << '\n';
+      return 1;
+    }
+    Expected<cxxlayout::TargetDescription> Description =
+        cxxlayout::TargetDescription::parse((*Buffer)->getBuffer());
+    if (!Description) {
+      WithColor::error(errs(), argv[0])
+          << TargetDescriptionFile << ": "
+          << toString(Description.takeError()) << '\n';
+      return 1;
+    }
+    Ctx.targetDescription = std::move(*Description);
+  }
+
+  // Reads the inputs from the revisions instead.
+  if (!DiffRevisions.empty())
+    return diffRevisions(argv[0]);
+  if (NDJson)
+    return streamRecords(argv[0]);
+
+  int Status = 0;
+  InputList Inputs;
+  for (const std::string &File : InputFiles) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(File);
+    if (!Buffer) {
+      WithColor::error(errs(), argv[0])
+          << File << ": " << Buffer.getError().message() << '\n';
+      Status = 1;
+      continue;
+    }
+    Inputs.emplace_back(File, std::move(*Buffer));
+  }
+
+  if (Lint || !LintConfig.empty())
+    return Status ? Status : lintRecords(Inputs, argv[0]);
+
+  if (!LookupPaths.empty())
+    return Status ? Status : lookupPaths(Inputs, argv[0]);
+
+  if (Copies)
+    return Status ? Status : reportCopies(Inputs);
+
+  if (!LockHeader.empty() || !ReflectionHeader.empty()) {
+    if (!ReflectionHeader.empty() && !Status)
+      Status = writeReflectionHeader(Inputs, argv[0]);
+    // Last, since it may switch targets.
+    if (!LockHeader.empty() && !Status)
+      Status = writeLockHeader(Inputs, argv[0]);
+    return Status;
+  }
+
+  bool First = true;
+  outs() << '[';
+  for (const auto &[File, Buffer] : Inputs) {
+    cxxlayout::analyzeCode(Buffer->getBuffer(), File);
+    if (!First)
+      outs() << ',';
+    writeRecords(outs(), File);
+    First = false;
+  }
+  outs() << "]\n";
+  return Status;
+}
+
+#endif // __EMSCRIPTEN__
@@ -0,0 +1,290 @@
+#include "FieldAccess.h"
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+
+using namespace llvm;
+
+namespace cxxlayout {
+
+static constexpr uint64_t LOOP_WEIGHT = 8;
+static constexpr unsigned MAX_LOOP_DEPTH = 4;
+// Scopes that access more fields of a record than this don't link them,
+// which bounds the number of pairs for huge functions.
+static constexpr size_t MAX_LINKED_FIELDS = 32;
+static constexpr size_t MAX_AFFINITIES = 16;
+static constexpr uint64_t CACHE_LINE_SIZE = 64;
+
+namespace {
+
+class AccessVisitor : public clang::RecursiveASTVisitor<AccessVisitor> {
+  using Base = clang::RecursiveASTVisitor<AccessVisitor>;
+
+  // A function body or a loop in it, with the fields accessed in it.
+  struct Scope {
+    uint64_t weight;
+    unsigned depth;
+    SmallSetVector<const clang::FieldDecl *, 16> fields;
+  };
+  SmallVector<Scope, 4> Scopes;
+  DenseMap<const clang::FieldDecl *, uint64_t> &Accesses;
+  DenseMap<const clang::RecordDecl *,
+           DenseMap<FieldAccessCollector::FieldPair, uint64_t>> &Affinity;
+
+  void link(const Scope &S) {
+    SmallVector<const clang::FieldDecl *, 16> Fields(S.fields.begin(),
+                                                     S.fields.end());
+    llvm::sort(Fields, [](const clang::FieldDecl *A,
+                          const clang::FieldDecl *B) {
+      return std::make_pair(A->getParent(), A->getFieldIndex()) <
+             std::make_pair(B->getParent(), B->getFieldIndex());
+    });
+    for (auto I = Fields.begin(), E = Fields.end(); I != E;) {
+      const clang::RecordDecl *Parent = (*I)->getParent();
+      auto End = std::find_if(I, E, [&](const clang::FieldDecl *F) {
+        return F->getParent() != Parent;
+      });
+      if (End - I >= 2 && static_cast<size_t>(End - I) <= MAX_LINKED_FIELDS) {
+        auto &Pairs = Affinity[Parent];
+        for (auto A = I; A != End; ++A)
+          for (auto B = A + 1; B != End; ++B)
+            Pairs[{(*A)->getFieldIndex(), (*B)->getFieldIndex()}] += S.weight;
+      }
+      I = End;
+    }
+  }
+
+  template <typename Fn> bool traverseScope(Fn Traverse) {
+    unsigned Depth = Scopes.back().depth + 1;
+    uint64_t Weight = Scopes.back().weight;
+    if (Depth <= MAX_LOOP_DEPTH)
+      Weight *= LOOP_WEIGHT;
+    Scopes.push_back({Weight, Depth, {}});
+    bool Result = Traverse();
+    link(Scopes.pop_back_val());
+    return Result;
+  }
+
+public:
+  AccessVisitor(
+      DenseMap<const clang::FieldDecl *, uint64_t> &Accesses,
+      DenseMap<const clang::RecordDecl *,
+               DenseMap<FieldAccessCollector::FieldPair, uint64_t>> &Affinity)
+      : Accesses(Accesses), Affinity(Affinity) {}
+
+  bool shouldVisitTemplateInstantiations() const { return true; }
+
+  // Functions nested in a body, such as lambdas and methods of local
+  // classes, count as part of it.
+  bool TraverseDecl(clang::Decl *D) {
+    const auto *FD = dyn_cast_or_null<clang::FunctionDecl>(D);
+    if (!FD || !Scopes.empty() || !FD->doesThisDeclarationHaveABody())
+      return Base::TraverseDecl(D);
+    // Templates are counted by their instantiations.
+    if (FD->isDependentContext())
+      return true;
+    Scopes.push_back({1, 0, {}});
+    bool Result = Base::TraverseDecl(D);
+    link(Scopes.pop_back_val());
+    return Result;
+  }
+  bool TraverseForStmt(clang::ForStmt *S) {
+    return traverseScope([&] { return Base::TraverseForStmt(S); });
+  }
+  bool TraverseCXXForRangeStmt(clang::CXXForRangeStmt *S) {
+    return traverseScope([&] { return Base::TraverseCXXForRangeStmt(S); });
+  }
+  bool TraverseWhileStmt(clang::WhileStmt *S) {
+    return traverseScope([&] { return Base::TraverseWhileStmt(S); });
+  }
+  bool TraverseDoStmt(clang::DoStmt *S) {
+    return traverseScope([&] { return Base::TraverseDoStmt(S); });
+  }
+
+  bool VisitMemberExpr(clang::MemberExpr *E) {
+    const auto *Field = dyn_cast<clang::FieldDecl>(E->getMemberDecl());
+    if (!Field || Scopes.empty())
+      return true;
+    Accesses[Field] += Scopes.back().weight;
+    for (Scope &S : Scopes)
+      S.fields.insert(Field);
+    return true;
+  }
+};
+
+// A field, or a run of adjacent bitfields, which can only move together.
+struct Unit {
+  unsigned first;
+  unsigned last;
+  uint64_t size; // in bytes
+  uint64_t align;
+  uint64_t accesses;
+};
+
+} // namespace
+
+void FieldAccessCollector::collect(clang::ASTContext &Ctx) {
+  AccessVisitor(Accesses, Affinity).TraverseAST(Ctx);
+}
+
+static std::string getDisplayName(const FieldInfo &Field) {
+  return Field.name.empty() ? Field.type : Field.name;
+}
+
+static std::vector<Unit> getUnits(ArrayRef<FieldInfoPtr> Fields) {
+  std::vector<Unit> Units;
+  for (unsigned I = 0, E = Fields.size(); I != E; ++I) {
+    const FieldInfo &F = *Fields[I];
+    clang::CharUnits FieldAlign =
+        F.fieldAlign.isZero() ? F.align : F.fieldAlign;
+    uint64_t Align = std::max<int64_t>(FieldAlign.getQuantity(), 1);
+    if (F.fieldType != FieldType::BitField) {
+      Units.push_back(
+          {I, I, static_cast<uint64_t>(F.size.getQuantity()), Align,
+           F.accesses});
+      continue;
+    }
+    if (Units.empty() ||
+        Fields[Units.back().last]->fieldType != FieldType::BitField)
+      Units.push_back({I, I, 0, Align, 0});
+    Unit &U = Units.back();
+    U.last = I;
+    U.align = std::max(U.align, Align);
+    U.accesses += F.accesses;
+    uint64_t Bits = F.offset + F.bitWidth - Fields[U.first]->offset;
+    U.size = alignTo(divideCeil(Bits, 8), U.align);
+  }
+  return Units;
+}
+
+// Greedily fills cache lines: each cluster starts with the hottest field not
+// placed yet and takes the field with the most affinity to the cluster that
+// still fits in the cache line, until none is linked to it. Fields that are
+// never accessed go last, by decreasing alignment.
+static void proposeOrder(FieldInfo &Record, ArrayRef<FieldInfoPtr> Fields,
+                         const DenseMap<FieldAccessCollector::FieldPair,
+                                        uint64_t> *Pairs) {
+  std::vector<Unit> Units = getUnits(Fields);
+  if (Units.size() < 2)
+    return;
+  std::vector<unsigned> UnitOf(Fields.size());
+  for (unsigned U = 0, E = Units.size(); U != E; ++U)
+    for (unsigned I = Units[U].first; I <= Units[U].last; ++I)
+      UnitOf[I] = U;
+  // Between units, smaller index first. Bitfields of one run are linked
+  // to their own unit, which doesn't matter.
+  DenseMap<std::pair<unsigned, unsigned>, uint64_t> UnitAffinity;
+  if (Pairs)
+    for (const auto &[Pair, Weight] : *Pairs)
+      UnitAffinity[{UnitOf[Pair.first], UnitOf[Pair.second]}] += Weight;
+
+  // Bases and the vptr stay in front.
+  uint64_t Offset = 0;
+  for (const FieldInfoPtr &F : Record.subFields)
+    if (F->fieldType == FieldType::VPtr || F->fieldType == FieldType::NVBase)
+      Offset = std::max<uint64_t>(Offset,
+                                  (F->offset >> 3) + F->size.getQuantity());
+
+  std::vector<unsigned> Order;
+  std::vector<bool> Placed(Units.size());
+  auto Place = [&](unsigned U) {
+    Offset = alignTo(Offset, Units[U].align) + Units[U].size;
+    Order.push_back(U);
+    Placed[U] = true;
+  };
+
+  std::vector<unsigned> Hot;
+  for (unsigned U = 0, E = Units.size(); U != E; ++U)
+    if (Units[U].accesses)
+      Hot.push_back(U);
+  if (Hot.empty())
+    return;
+  llvm::stable_sort(Hot, [&](unsigned A, unsigned B) {
+    return Units[A].accesses > Units[B].accesses;
+  });
+  for (unsigned Seed : Hot) {
+    if (Placed[Seed])
+      continue;
+    uint64_t Start = alignTo(Offset, Units[Seed].align);
+    Place(Seed);
+    uint64_t LineEnd =
+        std::max(alignTo(Start + 1, CACHE_LINE_SIZE), Offset);
+    SmallVector<unsigned, 8> Cluster{Seed};
+    while (true) {
+      std::optional<unsigned> Best;
+      uint64_t BestWeight = 0;
+      for (unsigned U : Hot) {
+        if (Placed[U] ||
+            alignTo(Offset, Units[U].align) + Units[U].size > LineEnd)
+          continue;
+        uint64_t Weight = 0;
+        for (unsigned C : Cluster)
+          Weight += UnitAffinity.lookup({std::min(U, C), std::max(U, C)});
+        if (Weight > BestWeight) {
+          Best = U;
+          BestWeight = Weight;
+        }
+      }
+      if (!Best)
+        break;
+      Place(*Best);
+      Cluster.push_back(*Best);
+    }
+  }
+
+  std::vector<unsigned> Cold;
+  for (unsigned U = 0, E = Units.size(); U != E; ++U)
+    if (!Placed[U])
+      Cold.push_back(U);
+  llvm::stable_sort(Cold, [&](unsigned A, unsigned B) {
+    return Units[A].align > Units[B].align;
+  });
+  for (unsigned U : Cold)
+    Place(U);
+
+  for (unsigned U : Order)
+    for (unsigned I = Units[U].first; I <= Units[U].last; ++I)
+      Record.proposedOrder.push_back(getDisplayName(*Fields[I]));
+  Record.proposedSize = clang::CharUnits::fromQuantity(
+      alignTo(Offset, std::max<int64_t>(Record.align.getQuantity(), 1)));
+}
+
+void FieldAccessCollector::annotate(const clang::RecordDecl *RD,
+                                    FieldInfo &Record) const {
+  // The fields come last, after the vptr and the bases.
+  size_t NumFields = std::distance(RD->field_begin(), RD->field_end());
+  if (NumFields > Record.subFields.size())
+    return;
+  ArrayRef<FieldInfoPtr> Fields =
+      ArrayRef<FieldInfoPtr>(Record.subFields).take_back(NumFields);
+  for (const clang::FieldDecl *Field : RD->fields())
+    Fields[Field->getFieldIndex()]->accesses = Accesses.lookup(Field);
+
+  auto It = Affinity.find(RD);
+  const DenseMap<FieldPair, uint64_t> *Pairs =
+      It == Affinity.end() ? nullptr : &It->second;
+  if (Pairs) {
+    std::vector<std::pair<FieldPair, uint64_t>> Sorted(Pairs->begin(),
+                                                       Pairs->end());
+    llvm::sort(Sorted, [](const auto &A, const auto &B) {
+      return A.second != B.second ? A.second > B.second : A.first < B.first;
+    });
+    if (Sorted.size() > MAX_AFFINITIES)
+      Sorted.resize(MAX_AFFINITIES);
+    for (const auto &[Pair, Weight] : Sorted)
+      Record.affinities.push_back({getDisplayName(*Fields[Pair.first]),
+                                   getDisplayName(*Fields[Pair.second]),
+                                   Weight});
+  }
+  if (!RD->isUnion())
+    proposeOrder(Record, Fields, Pairs);
+}
+
+} // namespace cxxlayout
@@ -0,0 +1,40 @@
+#ifndef CXXLAYOUT_FIELDACCESS_H
+#define CXXLAYOUT_FIELDACCESS_H
+
+#include "CxxLayout.h"
+
+#include "clang/AST/ASTContext.h"
+#include "llvm/ADT/DenseMap.h"
+#include <cstdint>
+#include <utility>
+
+namespace cxxlayout {
+
+// A static estimate of which fields are hot and which are used together, for
+// code there is no profile of. Every MemberExpr naming a field in a function
+// body is an access, weighted by 8 for each loop it is in. Two fields of a
+// record that are accessed in the same function are linked by 1, and by the
+// weight of each loop they are both accessed in.
+class FieldAccessCollector {
+public:
+  using FieldPair = std::pair<unsigned, unsigned>; // field indices, a < b
+
+private:
+  llvm::DenseMap<const clang::FieldDecl *, uint64_t> Accesses;
+  llvm::DenseMap<const clang::RecordDecl *,
+                 llvm::DenseMap<FieldPair, uint64_t>>
+      Affinity;
+
+public:
+  // Walks every function body of the translation unit.
+  void collect(clang::ASTContext &Ctx);
+
+  // Fills in the accesses of the fields of Record, the layout of RD, its
+  // strongest affinities and, for structs and classes, an order of the
+  // fields that puts those accessed together on the same cache lines.
+  void annotate(const clang::RecordDecl *RD, FieldInfo &Record) const;
+};
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_FIELDACCESS_H
@@ -0,0 +1,135 @@
+#include "CxxLayout.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace cxxlayout {
+
+FieldPathIndex::FieldPathIndex(const FieldInfo &Record) {
+  addMembers(Record, "", 0, {});
+}
+
+void FieldPathIndex::addMembers(const FieldInfo &Record, StringRef Prefix,
+                                uint64_t Offset,
+                                ArrayRef<Subscript> Subscripts) {
+  // Members of the record itself hide those of its bases, so bases come
+  // last and only add names that aren't taken yet.
+  for (const FieldInfoPtr &F : Record.subFields) {
+    if (!F || F->fieldType == FieldType::VPtr ||
+        F->fieldType == FieldType::NVBase)
+      continue;
+    if (F->name.empty()) {
+      if (F->fieldType == FieldType::Record)
+        addMembers(*F, Prefix, Offset + F->offset, Subscripts);
+      continue;
+    }
+    std::string Path =
+        Prefix.empty() ? F->name : (Prefix + "." + F->name).str();
+    addField(*F, std::move(Path), Offset + F->offset, Subscripts);
+  }
+  for (const FieldInfoPtr &F : Record.subFields)
+    if (F && F->fieldType == FieldType::NVBase)
+      addMembers(*F, Prefix, Offset + F->offset, Subscripts);
+}
+
+void FieldPathIndex::addField(const FieldInfo &Field, std::string Path,
+                              uint64_t Offset,
+                              ArrayRef<Subscript> Subscripts) {
+  Entry E{Field.fieldType,
+          Field.type,
+          Offset,
+          static_cast<uint64_t>(Field.size.getQuantity()),
+          Field.fieldType == FieldType::BitField ? Field.bitWidth : 0,
+          SmallVector<Subscript, 1>(Subscripts)};
+  if (!Entries.try_emplace(Path, std::move(E)).second)
+    return;
+  if (Field.fieldType == FieldType::Record)
+    addMembers(Field, Path, Offset, Subscripts);
+  if (Field.arrayDims.empty())
+    return;
+
+  // One entry per subscript: "a[]" is a row of `int a[2][3]`, "a[][]" an
+  // int.
+  SmallVector<Subscript, 4> Inner(Subscripts);
+  uint64_t ElementBits = Field.elementSize.getQuantity() * 8;
+  for (unsigned I = 0, N = Field.arrayDims.size(); I != N; ++I) {
+    uint64_t Stride = ElementBits;
+    std::string Type = Field.elementType;
+    for (unsigned J = I + 1; J != N; ++J) {
+      Stride *= Field.arrayDims[J];
+      Type += "[" + utostr(Field.arrayDims[J]) + "]";
+    }
+    Inner.push_back({Field.arrayDims[I], Stride});
+    Path += "[]";
+    bool IsRecord = I + 1 == N && Field.element;
+    Entries.try_emplace(
+        Path, Entry{IsRecord ? FieldType::Record : FieldType::Simple,
+                    std::move(Type), Offset, Stride / 8, 0,
+                    SmallVector<Subscript, 1>(Inner)});
+  }
+  if (Field.element)
+    addMembers(*Field.element, Path, Offset, Inner);
+}
+
+Expected<FieldLocation> FieldPathIndex::lookup(StringRef Path) const {
+  SmallString<64> Key;
+  SmallVector<uint64_t, 4> Indices;
+  StringRef Rest = Path.trim();
+  while (!Rest.empty()) {
+    if (!Key.empty() && !Rest.consume_front("."))
+      return createStringError("expected '.' or '[' in '" + Path + "'");
+    size_t NameEnd = Rest.find_first_of(".[");
+    StringRef Name = Rest.take_front(NameEnd).trim();
+    Rest = Rest.drop_front(std::min(NameEnd, Rest.size()));
+    if (Name.empty())
+      return createStringError("expected a member name in '" + Path + "'");
+    if (!Key.empty())
+      Key.push_back('.');
+    Key += Name;
+    while (Rest.consume_front("[")) {
+      size_t Close = Rest.find(']');
+      uint64_t N;
+      if (Close == StringRef::npos ||
+          Rest.take_front(Close).trim().getAsInteger(10, N))
+        return createStringError("expected an array index in '" + Path +
+                                 "'");
+      Indices.push_back(N);
+      Key += "[]";
+      Rest = Rest.drop_front(Close + 1);
+    }
+  }
+
+  auto It = Entries.find(Key);
+  if (It == Entries.end())
+    return createStringError("no member '" + Path + "'");
+  const Entry &E = It->second;
+  FieldLocation Location{E.fieldType, E.type, E.offset, E.size, E.bitWidth};
+  for (unsigned I = 0, N = Indices.size(); I != N; ++I) {
+    if (Indices[I] >= E.subscripts[I].bound)
+      return createStringError("index " + Twine(Indices[I]) + " of '" +
+                               Path + "' is out of bounds [0, " +
+                               Twine(E.subscripts[I].bound) + ")");
+    Location.offset += Indices[I] * E.subscripts[I].stride;
+  }
+  return Location;
+}
+
+void writeFieldLocationJson(raw_ostream &OS, StringRef Path,
+                            const FieldLocation &Location) {
+  OS << "{\"path\":\"";
+  writeEscaped(OS, Path);
+  OS << "\",\"fieldType\":\"" << fieldTypeToString(Location.fieldType)
+     << "\",\"type\":\"";
+  writeEscaped(OS, Location.type);
+  OS << "\",\"offset\":" << (Location.offset >> 3)
+     << ",\"size\":" << Location.size
+     << ",\"bitOffset\":" << Location.offset;
+  if (Location.fieldType == FieldType::BitField)
+    OS << ",\"bitWidth\":" << Location.bitWidth;
+  OS << '}';
+}
+
+} // namespace cxxlayout
@@ -0,0 +1,306 @@
+#include "Generators.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace cxxlayout {
+
+static std::optional<std::string> getArchGuard(const Triple &T) {
+  switch (T.getArch()) {
+  case Triple::x86_64:
+    return "(defined(__x86_64__) || defined(_M_X64))";
+  case Triple::x86:
+    return "(defined(__i386__) || defined(_M_IX86))";
+  case Triple::aarch64:
+    return "(defined(__aarch64__) || defined(_M_ARM64))";
+  case Triple::arm:
+  case Triple::thumb:
+    return "(defined(__arm__) || defined(_M_ARM))";
+  case Triple::riscv32:
+    return "(defined(__riscv) && __riscv_xlen == 32)";
+  case Triple::riscv64:
+    return "(defined(__riscv) && __riscv_xlen == 64)";
+  case Triple::wasm32:
+    return "defined(__wasm32__)";
+  case Triple::wasm64:
+    return "defined(__wasm64__)";
+  case Triple::ppc:
+    return "(defined(__powerpc__) && !defined(__powerpc64__))";
+  case Triple::ppc64:
+    return "(defined(__powerpc64__) && defined(__BIG_ENDIAN__))";
+  case Triple::ppc64le:
+    return "(defined(__powerpc64__) && defined(__LITTLE_ENDIAN__))";
+  case Triple::systemz:
+    return "defined(__s390x__)";
+  case Triple::loongarch64:
+    return "defined(__loongarch64)";
+  default:
+    return std::nullopt;
+  }
+}
+
+// OS and, where it changes the ABI, environment. Empty for freestanding
+// targets.
+static std::string getOSGuard(const Triple &T) {
+  if (T.isAndroid())
+    return "defined(__ANDROID__)";
+  if (T.isOSLinux())
+    return "(defined(__linux__) && !defined(__ANDROID__))";
+  if (T.isOSDarwin())
+    return "defined(__APPLE__)";
+  if (T.isWindowsMSVCEnvironment())
+    return "(defined(_WIN32) && defined(_MSC_VER))";
+  if (T.isOSWindows())
+    return "(defined(_WIN32) && !defined(_MSC_VER))";
+  if (T.isOSFreeBSD())
+    return "defined(__FreeBSD__)";
+  if (T.isOSNetBSD())
+    return "defined(__NetBSD__)";
+  if (T.isOSOpenBSD())
+    return "defined(__OpenBSD__)";
+  if (T.isOSEmscripten())
+    return "defined(__EMSCRIPTEN__)";
+  if (T.isOSWASI())
+    return "defined(__wasi__)";
+  return "";
+}
+
+std::optional<std::string> getTargetGuard(const Triple &Triple) {
+  std::optional<std::string> Guard = getArchGuard(Triple);
+  if (!Guard)
+    return std::nullopt;
+  std::string OS = getOSGuard(Triple);
+  if (!OS.empty())
+    *Guard += " && " + OS;
+  return Guard;
+}
+
+Error LayoutLockWriter::addRecords(const LayoutContext &Ctx) {
+  // A lock missing records or holding wrong layouts would pass where it
+  // should fail.
+  if (Ctx.hasErrors)
+    return createStringError("the input has compile errors, so its layouts "
+                             "can't be locked");
+  Triple T(Ctx.targetTriple);
+  std::optional<std::string> Guard = getTargetGuard(T);
+  if (!Guard)
+    return createStringError("no preprocessor guard known for target '" +
+                             Ctx.targetTriple + "'");
+
+  auto It = llvm::find_if(Targets, [&](const TargetLocks &L) {
+    return L.triple == Ctx.targetTriple;
+  });
+  if (It == Targets.end()) {
+    Targets.push_back({Ctx.targetTriple, *Guard, {}});
+    It = std::prev(Targets.end());
+  }
+
+  for (const auto &R : Ctx.records) {
+    const FieldInfo &Info = *R.second;
+    if (!Info.isValid)
+      return createStringError("the layout of '" + Info.type +
+                               "' is invalid, so it can't be locked");
+    if (Info.spelling.empty())
+      continue;
+    RecordLock Lock{Info.type, Info.spelling,
+                    static_cast<uint64_t>(Info.size.getQuantity()),
+                    static_cast<uint64_t>(Info.align.getQuantity()),
+                    {}};
+    // offsetof on a class with virtual bases is ill-formed, and bitfields
+    // have no address.
+    if (!Info.hasVirtualBases) {
+      for (const FieldInfoPtr &F : Info.subFields) {
+        if (F && F->isPublic && !F->name.empty() &&
+            (F->fieldType == FieldType::Simple ||
+             F->fieldType == FieldType::Record))
+          Lock.offsets.emplace_back(F->name, F->offset >> 3);
+      }
+    }
+    // The same record seen again in another file of the same target.
+    It->records.emplace(Info.spelling, std::move(Lock));
+  }
+  return Error::success();
+}
+
+void LayoutLockWriter::write(raw_ostream &OS) const {
+  OS << "// Layout locks generated by clang-cxx-layout. Regenerate this file "
+        "instead of\n"
+     << "// editing it when a layout change is intended.\n"
+     << "//\n"
+     << "// Targets:";
+  for (const TargetLocks &Target : Targets)
+    OS << ' ' << Target.triple;
+  OS << "\n\n"
+     << "#pragma once\n\n"
+     << "#include <cstddef>\n\n"
+     // Plain offsetof is only guaranteed for standard-layout classes, but
+     // the compilers that define these guards support it for any class
+     // without virtual bases.
+     << "#if defined(__GNUC__)\n"
+     << "#pragma GCC diagnostic push\n"
+     << "#pragma GCC diagnostic ignored \"-Winvalid-offsetof\"\n"
+     << "#endif\n";
+
+  for (const auto &Target : llvm::enumerate(Targets)) {
+    const TargetLocks &Locks = Target.value();
+    OS << '\n'
+       << (Target.index() == 0 ? "#if " : "#elif ") << Locks.guard << " // "
+       << Locks.triple << '\n';
+    unsigned AliasCount = 0;
+    for (const auto &It : Locks.records) {
+      const RecordLock &Lock = It.second;
+      // offsetof is a macro, so a template-id with commas in it has to be
+      // named through an alias.
+      std::string Type = Lock.spelling;
+      if (StringRef(Type).contains(',')) {
+        std::string Alias = "t" + utostr(AliasCount++);
+        OS << "namespace cxx_layout_lock { using " << Alias << " = " << Type
+           << "; }\n";
+        Type = "cxx_layout_lock::" + Alias;
+      }
+      OS << "static_assert(sizeof(" << Type << ") == " << Lock.size
+         << ", \"size of " << Lock.name << " changed\");\n";
+      OS << "static_assert(alignof(" << Type << ") == " << Lock.align
+         << ", \"alignment of " << Lock.name << " changed\");\n";
+      for (const auto &[Field, Offset] : Lock.offsets)
+        OS << "static_assert(offsetof(" << Type << ", " << Field
+           << ") == " << Offset << ", \"offset of " << Lock.name
+           << "::" << Field << " changed\");\n";
+    }
+  }
+  // A target without locks would otherwise check nothing.
+  if (!Targets.empty())
+    OS << "#else\n"
+       << "#error \"no layout lock for this target\"\n"
+       << "#endif\n";
+
+  OS << '\n'
+     << "#if defined(__GNUC__)\n"
+     << "#pragma GCC diagnostic pop\n"
+     << "#endif\n";
+}
+
+Error ReflectionTableWriter::addRecords(const LayoutContext &Ctx) {
+  if (Triple.empty())
+    Triple = Ctx.targetTriple;
+  else if (Triple != Ctx.targetTriple)
+    return createStringError("reflection tables are for a single target, "
+                             "but inputs were analyzed for both '" +
+                             Triple + "' and '" + Ctx.targetTriple + "'");
+
+  for (const auto &R : Ctx.records) {
+    const FieldInfo &Info = *R.second;
+    if (!Info.isValid || Info.spelling.empty() ||
+        Tables.count(Info.spelling))
+      continue;
+    Table T{Info.type,
+            static_cast<uint64_t>(Info.size.getQuantity()),
+            static_cast<uint64_t>(Info.align.getQuantity()),
+            {},
+            {}};
+    for (const FieldInfoPtr &F : Info.subFields) {
+      if (!F)
+        continue;
+      // Bases are listed by their type, unnamed members as they are.
+      T.fields.push_back({F->fieldType == FieldType::NVBase ? F->type : F->name,
+                          F->offset,
+                          static_cast<uint64_t>(F->size.getQuantity()),
+                          F->fieldType, F->bitWidth});
+    }
+
+    T.runs = getDataRanges(Info, /*IncludeVPtr=*/false);
+    Tables.emplace(Info.spelling, std::move(T));
+  }
+  return Error::success();
+}
+
+static StringRef getKindName(FieldType Kind) {
+  switch (Kind) {
+  case FieldType::Simple:
+    return "Simple";
+  case FieldType::Record:
+    return "Record";
+  case FieldType::BitField:
+    return "BitField";
+  case FieldType::NVBase:
+  case FieldType::VBase:
+    return "Base";
+  case FieldType::VPtr:
+    return "VPtr";
+  }
+  llvm_unreachable("unknown field type");
+}
+
+void ReflectionTableWriter::write(raw_ostream &OS) const {
+  OS << "// Reflection tables generated by clang-cxx-layout for " << Triple
+     << ".\n"
+     << "// Regenerate this file instead of editing it.\n\n"
+     << "#pragma once\n\n"
+     << "#include <array>\n"
+     << "#include <cstddef>\n"
+     << "#include <cstdint>\n\n";
+  if (std::optional<std::string> Guard = getTargetGuard(llvm::Triple(Triple)))
+    OS << "#if !(" << *Guard << ")\n"
+       << "#error \"these layouts were computed for " << Triple << "\"\n"
+       << "#endif\n\n";
+
+  // Shared by all generated headers, which may be included together.
+  OS << R"(#ifndef CXX_LAYOUT_REFLECT_TYPES
+#define CXX_LAYOUT_REFLECT_TYPES
+namespace cxx_layout_reflect {
+
+enum class FieldKind : std::uint8_t { Simple, Record, BitField, Base, VPtr };
+
+struct Field {
+  const char *name;  // the type for bases, empty for unnamed members
+  std::size_t offset; // in bytes; for bitfields, of the byte of the first bit
+  std::size_t size;   // in bytes; for bitfields, of the declared type
+  FieldKind kind;
+  std::uint8_t bitOffset; // bitfields: first bit within the byte at offset
+  std::uint32_t bitWidth; // bitfields only
+};
+
+// Bytes [offset, offset + size) of a record that hold data with no padding
+// in between. Copying all runs of a record copies all of its data.
+struct Run {
+  std::size_t offset;
+  std::size_t size;
+};
+
+template <class T> struct Layout;
+
+} // namespace cxx_layout_reflect
+#endif // CXX_LAYOUT_REFLECT_TYPES
+
+namespace cxx_layout_reflect {
+)";
+
+  for (const auto &[Spelling, T] : Tables) {
+    OS << "\ntemplate <> struct Layout<" << Spelling << "> {\n"
+       << "  static constexpr const char *name = \"" << T.name << "\";\n"
+       << "  static constexpr std::size_t size = " << T.size << ";\n"
+       << "  static constexpr std::size_t align = " << T.align << ";\n"
+       << "  static constexpr std::array<Field, " << T.fields.size()
+       << "> fields{{\n";
+    for (const FieldEntry &F : T.fields) {
+      bool IsBitField = F.kind == FieldType::BitField;
+      OS << "      {\"" << F.name << "\", " << (F.offset >> 3) << ", " << F.size
+         << ", FieldKind::" << getKindName(F.kind) << ", "
+         << (IsBitField ? F.offset & 7 : 0) << ", "
+         << (IsBitField ? F.bitWidth : 0) << "},\n";
+    }
+    OS << "  }};\n"
+       << "  static constexpr std::array<Run, " << T.runs.size()
+       << "> runs{{\n";
+    for (const auto &[Begin, End] : T.runs)
+      OS << "      {" << Begin << ", " << End - Begin << "},\n";
+    OS << "  }};\n"
+       << "};\n";
+  }
+  OS << "\n} // namespace cxx_layout_reflect\n";
+}
+
+} // namespace cxxlayout
@@ -0,0 +1,84 @@
+#ifndef CXXLAYOUT_GENERATORS_H
+#define CXXLAYOUT_GENERATORS_H
+
+#include "CxxLayout.h"
+
+#include "llvm/Support/Error.h"
+#include "llvm/TargetParser/Triple.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cxxlayout {
+
+// The preprocessor condition under which code is being compiled for Triple,
+// built from the macros clang, GCC and MSVC predefine for its architecture
+// and OS. None if the architecture has no known macro.
+std::optional<std::string> getTargetGuard(const llvm::Triple &Triple);
+
+// Turns the records of one or more analyses, each possibly for a different
+// target, into a header of static_asserts on their size, alignment and field
+// offsets. Every target gets its own block, guarded by getTargetGuard, so a
+// single header locks the layouts of all of them. Compiling it for any other
+// target is an error.
+class LayoutLockWriter {
+  struct RecordLock {
+    std::string name;
+    std::string spelling;
+    uint64_t size;
+    uint64_t align;
+    std::vector<std::pair<std::string, uint64_t>> offsets; // public fields
+  };
+  struct TargetLocks {
+    std::string triple;
+    std::string guard;
+    std::map<std::string, RecordLock> records; // by spelling
+  };
+  std::vector<TargetLocks> Targets;
+
+public:
+  // Adds the records of the last analysis in Ctx. Records that can't be
+  // named from a header, like local or anonymous ones, are skipped. Fails
+  // if the target of the analysis has no guard.
+  llvm::Error addRecords(const LayoutContext &Ctx);
+
+  void write(llvm::raw_ostream &OS) const;
+};
+
+// Turns the records of one or more analyses for the same target into a
+// header of constexpr reflection tables: for every record a specialization
+// of cxx_layout_reflect::Layout<T> listing its fields as {name, offset,
+// size, kind}, and the runs of bytes covered by its data without padding in
+// between, so that serializers can copy each run with a single memcpy.
+class ReflectionTableWriter {
+  struct FieldEntry {
+    std::string name;
+    uint64_t offset; // in bits
+    uint64_t size;
+    FieldType kind;
+    uint64_t bitWidth;
+  };
+  struct Table {
+    std::string name;
+    uint64_t size;
+    uint64_t align;
+    std::vector<FieldEntry> fields;
+    std::vector<std::pair<uint64_t, uint64_t>> runs; // [begin, end) in bytes
+  };
+  std::string Triple;
+  std::map<std::string, Table> Tables; // by spelling
+
+public:
+  // Adds the records of the last analysis in Ctx. Records that can't be
+  // named from a header are skipped. Fails if the analysis was for a
+  // different target than the previous ones.
+  llvm::Error addRecords(const LayoutContext &Ctx);
+
+  void write(llvm::raw_ostream &OS) const;
+};
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_GENERATORS_H
@@ -0,0 +1,325 @@
+#include "HeaderPruning.h"
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/Type.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/MacroInfo.h"
+#include "clang/Lex/Token.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace cxxlayout {
+
+void HeaderDependencyCollector::addFile(clang::FileID FID) {
+  while (FID.isValid() && SM.isInSystemHeader(SM.getLocForStartOfFile(FID))) {
+    clang::SourceLocation IncludeLoc = SM.getIncludeLoc(FID);
+    if (IncludeLoc.isInvalid() || !SM.isInSystemHeader(IncludeLoc))
+      break;
+    FID = SM.getFileID(IncludeLoc);
+  }
+  if (FID.isValid() && FID != SM.getMainFileID())
+    Files.insert(FID);
+}
+
+void HeaderDependencyCollector::addLoc(clang::SourceLocation Loc) {
+  if (Loc.isInvalid())
+    return;
+  addFile(SM.getFileID(SM.getExpansionLoc(Loc)));
+}
+
+void HeaderDependencyCollector::addDecl(const clang::Decl *D,
+                                        bool NeedDefinition) {
+  if (!D)
+    return;
+  if (const auto *TD = dyn_cast<clang::TagDecl>(D)) {
+    if (!NeedDefinition)
+      D = TD->getCanonicalDecl();
+    else if (const clang::TagDecl *Def = TD->getDefinition())
+      D = Def;
+  }
+  if (!Visited.insert(D).second)
+    return;
+  addLoc(D->getLocation());
+
+  // A nested type needs its enclosing class to be complete.
+  if (const auto *Parent = dyn_cast<clang::TagDecl>(D->getDeclContext()))
+    addDecl(Parent, true);
+
+  if (const auto *TND = dyn_cast<clang::TypedefNameDecl>(D)) {
+    addType(TND->getUnderlyingType(), NeedDefinition);
+    return;
+  }
+  if (!NeedDefinition)
+    return;
+
+  if (const auto *Spec = dyn_cast<clang::ClassTemplateSpecializationDecl>(D)) {
+    addDecl(Spec->getSpecializedTemplate(), false);
+    for (const clang::TemplateArgument &Arg :
+         Spec->getTemplateArgs().asArray())
+      if (Arg.getKind() == clang::TemplateArgument::Type)
+        addType(Arg.getAsType(), false);
+  }
+  if (const auto *RD = dyn_cast<clang::CXXRecordDecl>(D)) {
+    for (const clang::CXXBaseSpecifier &Base : RD->bases())
+      addType(Base.getType(), true);
+    for (const clang::FieldDecl *Field : RD->fields())
+      addType(Field->getType(), true);
+  } else if (const auto *ED = dyn_cast<clang::EnumDecl>(D)) {
+    if (ED->isFixed())
+      addType(ED->getIntegerType(), false);
+  }
+}
+
+void HeaderDependencyCollector::addType(clang::QualType T,
+                                        bool NeedDefinition) {
+  while (!T.isNull()) {
+    const clang::Type *Ty = T.getTypePtr();
+    if (const auto *TT = dyn_cast<clang::TypedefType>(Ty)) {
+      addDecl(TT->getDecl(), NeedDefinition);
+      return;
+    }
+    if (const auto *TT = dyn_cast<clang::TagType>(Ty)) {
+      addDecl(TT->getDecl(), NeedDefinition);
+      return;
+    }
+    if (const auto *PT = dyn_cast<clang::PointerType>(Ty)) {
+      T = PT->getPointeeType();
+      NeedDefinition = false;
+      continue;
+    }
+    if (const auto *RT = dyn_cast<clang::ReferenceType>(Ty)) {
+      T = RT->getPointeeType();
+      NeedDefinition = false;
+      continue;
+    }
+    if (const auto *MPT = dyn_cast<clang::MemberPointerType>(Ty)) {
+      addDecl(MPT->getMostRecentCXXRecordDecl(), false);
+      T = MPT->getPointeeType();
+      NeedDefinition = false;
+      continue;
+    }
+    if (const auto *AT = dyn_cast<clang::ArrayType>(Ty)) {
+      T = AT->getElementType();
+      continue;
+    }
+    if (const auto *FT = dyn_cast<clang::FunctionProtoType>(Ty)) {
+      addType(FT->getReturnType(), false);
+      for (clang::QualType Param : FT->getParamTypes())
+        addType(Param, false);
+      return;
+    }
+    if (const auto *TST = dyn_cast<clang::TemplateSpecializationType>(Ty))
+      addDecl(TST->getTemplateName().getAsTemplateDecl(), false);
+    if (!Ty->isSugared())
+      return;
+    T = Ty->getLocallyUnqualifiedSingleStepDesugaredType();
+  }
+}
+
+namespace {
+
+class UseVisitor : public clang::RecursiveASTVisitor<UseVisitor> {
+  HeaderDependencyCollector &Deps;
+
+public:
+  explicit UseVisitor(HeaderDependencyCollector &Deps) : Deps(Deps) {}
+
+  bool VisitTypeLoc(clang::TypeLoc TL) {
+    Deps.addType(TL.getType(), true);
+    return true;
+  }
+  bool VisitDeclRefExpr(clang::DeclRefExpr *E) {
+    Deps.addDecl(E->getDecl());
+    Deps.addDecl(E->getFoundDecl());
+    return true;
+  }
+  bool VisitMemberExpr(clang::MemberExpr *E) {
+    Deps.addDecl(E->getMemberDecl());
+    Deps.addType(E->getBase()->getType(), true);
+    return true;
+  }
+  bool VisitOverloadExpr(clang::OverloadExpr *E) {
+    for (const clang::NamedDecl *D : E->decls())
+      Deps.addDecl(D);
+    return true;
+  }
+  bool VisitCXXConstructExpr(clang::CXXConstructExpr *E) {
+    Deps.addDecl(E->getConstructor());
+    return true;
+  }
+  bool VisitCXXNewExpr(clang::CXXNewExpr *E) {
+    Deps.addDecl(E->getOperatorNew());
+    return true;
+  }
+  bool VisitUsingDecl(clang::UsingDecl *D) {
+    for (const clang::UsingShadowDecl *Shadow : D->shadows())
+      Deps.addDecl(Shadow->getTargetDecl());
+    return true;
+  }
+};
+
+} // namespace
+
+void HeaderDependencyCollector::addUses(const clang::Decl *D) {
+  addDecl(D);
+  UseVisitor(*this).TraverseDecl(const_cast<clang::Decl *>(D));
+}
+
+std::vector<std::string> HeaderDependencyCollector::getIncludes() const {
+  std::vector<std::string> Includes;
+  llvm::StringSet<> Seen;
+  for (clang::FileID FID : Files) {
+    clang::OptionalFileEntryRef FE = SM.getFileEntryRefForID(FID);
+    if (FE && Seen.insert(FE->getName()).second)
+      Includes.push_back(FE->getName().str());
+  }
+  return Includes;
+}
+
+namespace {
+
+class MacroUseCollector : public clang::PPCallbacks {
+  const clang::SourceManager &SM;
+  std::set<clang::FileID> &Files;
+
+  void addUse(clang::SourceLocation UseLoc, const clang::MacroDefinition &MD) {
+    const clang::MacroInfo *MI = MD.getMacroInfo();
+    if (!MI || !SM.isInMainFile(SM.getExpansionLoc(UseLoc)))
+      return;
+    clang::SourceLocation DefLoc = MI->getDefinitionLoc();
+    if (DefLoc.isValid())
+      Files.insert(SM.getFileID(SM.getExpansionLoc(DefLoc)));
+  }
+
+public:
+  MacroUseCollector(const clang::SourceManager &SM,
+                    std::set<clang::FileID> &Files)
+      : SM(SM), Files(Files) {}
+
+  void MacroExpands(const clang::Token &MacroNameTok,
+                    const clang::MacroDefinition &MD, clang::SourceRange Range,
+                    const clang::MacroArgs *Args) override {
+    addUse(Range.getBegin(), MD);
+  }
+  void Defined(const clang::Token &MacroNameTok,
+               const clang::MacroDefinition &MD,
+               clang::SourceRange Range) override {
+    addUse(Range.getBegin(), MD);
+  }
+  void Ifdef(clang::SourceLocation Loc, const clang::Token &MacroNameTok,
+             const clang::MacroDefinition &MD) override {
+    addUse(Loc, MD);
+  }
+  void Ifndef(clang::SourceLocation Loc, const clang::Token &MacroNameTok,
+              const clang::MacroDefinition &MD) override {
+    addUse(Loc, MD);
+  }
+};
+
+class IncludeDirectiveCollector : public clang::PPCallbacks {
+  const clang::SourceManager &SM;
+  std::vector<unsigned> &Lines;
+
+public:
+  IncludeDirectiveCollector(const clang::SourceManager &SM,
+                            std::vector<unsigned> &Lines)
+      : SM(SM), Lines(Lines) {}
+
+  void InclusionDirective(clang::SourceLocation HashLoc,
+                          const clang::Token &IncludeTok, StringRef FileName,
+                          bool IsAngled, clang::CharSourceRange FilenameRange,
+                          clang::OptionalFileEntryRef File,
+                          StringRef SearchPath, StringRef RelativePath,
+                          const clang::Module *SuggestedModule,
+                          bool ModuleImported,
+                          clang::SrcMgr::CharacteristicKind FileType) override {
+    if (SM.isWrittenInMainFile(HashLoc))
+      Lines.push_back(SM.getSpellingLineNumber(HashLoc));
+  }
+};
+
+} // namespace
+
+std::unique_ptr<clang::PPCallbacks>
+createMacroUseCollector(const clang::SourceManager &SM,
+                        std::set<clang::FileID> &Files) {
+  return std::make_unique<MacroUseCollector>(SM, Files);
+}
+
+std::unique_ptr<clang::PPCallbacks>
+createIncludeDirectiveCollector(const clang::SourceManager &SM,
+                                std::vector<unsigned> &Lines) {
+  return std::make_unique<IncludeDirectiveCollector>(SM, Lines);
+}
+
+bool isIncludeLine(StringRef Line) {
+  Line = Line.ltrim();
+  if (!Line.consume_front("#"))
+    return false;
+  Line = Line.ltrim();
+  return Line.starts_with("include") || Line.starts_with("import");
+}
+
+std::string getIncludeLines(StringRef Source) {
+  std::string Lines;
+  SmallVector<StringRef> SourceLines;
+  Source.split(SourceLines, '\n');
+  for (StringRef Line : SourceLines) {
+    if (!isIncludeLine(Line))
+      continue;
+    Lines.append(Line.trim().str());
+    Lines.push_back('\n');
+  }
+  return Lines;
+}
+
+std::vector<bool> getProcessedIncludes(StringRef Source,
+                                       ArrayRef<unsigned> DirectiveLines) {
+  llvm::DenseSet<unsigned> Directives(DirectiveLines.begin(),
+                                      DirectiveLines.end());
+  std::vector<bool> Processed;
+  SmallVector<StringRef> SourceLines;
+  Source.split(SourceLines, '\n');
+  for (unsigned I = 0, E = SourceLines.size(); I != E; ++I)
+    if (isIncludeLine(SourceLines[I]))
+      Processed.push_back(Directives.contains(I + 1));
+  return Processed;
+}
+
+std::optional<std::string>
+buildPrunedSource(StringRef Source, const std::vector<std::string> &Includes,
+                  const std::vector<bool> &Processed, StringRef FileName) {
+  std::string Pruned;
+  llvm::raw_string_ostream OS(Pruned);
+  // Header names have no escape sequences, so a quote or line break can't
+  // be spelled in one.
+  for (const std::string &Include : Includes) {
+    if (StringRef(Include).find_first_of("\"\r\n") != StringRef::npos)
+      return std::nullopt;
+    OS << "#include \"" << Include << "\"\n";
+  }
+  OS << "#line 1 \"";
+  OS.write_escaped(FileName);
+  OS << "\"\n";
+  SmallVector<StringRef> SourceLines;
+  Source.split(SourceLines, '\n');
+  unsigned Include = 0;
+  for (unsigned I = 0, E = SourceLines.size(); I != E; ++I) {
+    if (isIncludeLine(SourceLines[I]) && Include < Processed.size() &&
+        Processed[Include++])
+      OS.indent(SourceLines[I].size());
+    else
+      OS << SourceLines[I];
+    if (I + 1 != E)
+      OS << '\n';
+  }
+  OS.flush();
+  return Pruned;
+}
+
+} // namespace cxxlayout
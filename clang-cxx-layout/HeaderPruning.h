@@ -0,0 +1,86 @@
+#ifndef CXXLAYOUT_HEADERPRUNING_H
+#define CXXLAYOUT_HEADERPRUNING_H
+
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cxxlayout {
+
+// Collects the headers that the definitions of a set of records transitively
+// depend on: the headers declaring the records themselves, their bases,
+// field types, typedefs and enclosing classes. Types only reached through
+// pointers or references contribute their declaration, not their definition.
+// Internal system headers such as bits/stl_vector.h don't compile on their
+// own, so the system header that user code included stands in for them.
+class HeaderDependencyCollector {
+  const clang::SourceManager &SM;
+  llvm::DenseSet<const clang::Decl *> Visited;
+  std::set<clang::FileID> Files; // ordered by inclusion
+
+  void addLoc(clang::SourceLocation Loc);
+
+public:
+  explicit HeaderDependencyCollector(const clang::SourceManager &SM)
+      : SM(SM) {}
+
+  void addDecl(const clang::Decl *D, bool NeedDefinition = true);
+  void addType(clang::QualType T, bool NeedDefinition);
+  // Adds D and what its declaration and definition use: the declarations
+  // it refers to, the types it spells and the records whose members it
+  // accesses.
+  void addUses(const clang::Decl *D);
+  void addFile(clang::FileID FID);
+
+  // Paths of the collected headers, in the order they were first included.
+  std::vector<std::string> getIncludes() const;
+};
+
+// Records the files defining macros that are expanded or tested in the main
+// file, since a header can be needed for its macros alone.
+std::unique_ptr<clang::PPCallbacks>
+createMacroUseCollector(const clang::SourceManager &SM,
+                        std::set<clang::FileID> &Files);
+
+// Records the lines of the main file holding an #include or #import
+// directive the preprocessor processed.
+std::unique_ptr<clang::PPCallbacks>
+createIncludeDirectiveCollector(const clang::SourceManager &SM,
+                                std::vector<unsigned> &Lines);
+
+// Whether Line looks like an #include or #import directive.
+bool isIncludeLine(llvm::StringRef Line);
+
+// The lines of Source that look like #include directives, which decide
+// whether a pruned include set computed for an earlier version of Source
+// can still be used.
+std::string getIncludeLines(llvm::StringRef Source);
+
+// For each line of Source that looks like an #include directive, in order,
+// whether it is one of the processed DirectiveLines. The others are in
+// skipped conditional blocks, comments or raw strings.
+std::vector<bool> getProcessedIncludes(llvm::StringRef Source,
+                                       llvm::ArrayRef<unsigned> DirectiveLines);
+
+// Source with the #include directives marked in Processed, as returned by
+// getProcessedIncludes for a source with the same include lines, blanked
+// out and Includes included up front instead. Line numbers of the main file
+// are preserved, and so are byte offsets relative to the end of the prefix.
+// None if an include path can't be spelled in an #include directive.
+std::optional<std::string>
+buildPrunedSource(llvm::StringRef Source,
+                  const std::vector<std::string> &Includes,
+                  const std::vector<bool> &Processed,
+                  llvm::StringRef FileName);
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_HEADERPRUNING_H
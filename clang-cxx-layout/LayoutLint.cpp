@@ -0,0 +1,221 @@
+#include "LayoutLint.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <functional>
+
+using namespace llvm;
+
+namespace cxxlayout {
+
+Error LayoutBudget::parse(StringRef Spec) {
+  SmallVector<StringRef> Items;
+  Spec.split(Items, ',', -1, /*KeepEmpty=*/false);
+  for (StringRef Item : Items) {
+    auto [Key, Value] = Item.trim().split('=');
+    Key = Key.trim();
+    Value = Value.trim();
+    if (Key == "cache_aligned") {
+      cacheAligned = true;
+      continue;
+    }
+    if (Key == "no_vptr") {
+      noVPtr = true;
+      continue;
+    }
+    std::optional<uint64_t> *Limit =
+        StringSwitch<std::optional<uint64_t> *>(Key)
+            .Case("max_size", &maxSize)
+            .Case("max_padding", &maxPadding)
+            .Case("align", &align)
+            .Default(nullptr);
+    if (!Limit)
+      return createStringError("unknown layout budget '" + Key + "'");
+    uint64_t N;
+    if (Value.getAsInteger(10, N))
+      return createStringError("layout budget '" + Key +
+                               "' needs a number, got '" + Value + "'");
+    *Limit = N;
+  }
+  return Error::success();
+}
+
+Expected<LayoutLinter> LayoutLinter::fromConfig(StringRef Json) {
+  Expected<json::Value> Config = json::parse(Json);
+  if (!Config)
+    return Config.takeError();
+  const json::Object *Root = Config->getAsObject();
+  if (!Root)
+    return createStringError("lint config must be a JSON object");
+
+  LayoutLinter Linter;
+  if (std::optional<int64_t> CacheLine = Root->getInteger("cache_line")) {
+    if (*CacheLine <= 0)
+      return createStringError("cache_line must be positive");
+    Linter.CacheLine = *CacheLine;
+  }
+  const json::Array *Rules = Root->getArray("rules");
+  if (!Rules)
+    return Linter;
+  for (const json::Value &V : *Rules) {
+    const json::Object *Obj = V.getAsObject();
+    if (!Obj)
+      return createStringError("lint rules must be JSON objects");
+    Rule R{Regex(Obj->getString("match").value_or("")), {}};
+    std::string RegexError;
+    if (!R.match.isValid(RegexError))
+      return createStringError("invalid rule match: " + RegexError);
+    for (const char *Key : {"max_size", "max_padding", "align"}) {
+      if (const json::Value *Limit = Obj->get(Key)) {
+        std::optional<int64_t> N = Limit->getAsInteger();
+        if (!N || *N < 0)
+          return createStringError(Twine(Key) + " must be a number");
+        if (Error E = R.budget.parse((Twine(Key) + "=" + Twine(*N)).str()))
+          return std::move(E);
+      }
+    }
+    R.budget.cacheAligned = Obj->getBoolean("cache_aligned").value_or(false);
+    R.budget.noVPtr = Obj->getBoolean("no_vptr").value_or(false);
+    if (const json::Array *Hot = Obj->getArray("hot_fields"))
+      for (const json::Value &Name : *Hot)
+        if (std::optional<StringRef> S = Name.getAsString())
+          R.budget.hotFields.push_back(S->str());
+    Linter.Rules.push_back(std::move(R));
+  }
+  return Linter;
+}
+
+Expected<LayoutBudget> LayoutLinter::getBudget(const FieldInfo &Record) const {
+  LayoutBudget Budget;
+  for (const Rule &R : Rules) {
+    if (!R.match.match(Record.type))
+      continue;
+    const LayoutBudget &B = R.budget;
+    if (B.maxSize)
+      Budget.maxSize = B.maxSize;
+    if (B.maxPadding)
+      Budget.maxPadding = B.maxPadding;
+    if (B.align)
+      Budget.align = B.align;
+    Budget.cacheAligned |= B.cacheAligned;
+    Budget.noVPtr |= B.noVPtr;
+    llvm::append_range(Budget.hotFields, B.hotFields);
+  }
+
+  for (const std::string &Annotation : Record.annotations)
+    if (Error E = Budget.parse(Annotation))
+      return createStringError(Record.type + ": " + toString(std::move(E)));
+  for (const FieldInfoPtr &F : Record.subFields)
+    if (F && !F->name.empty() && llvm::is_contained(F->annotations, "hot"))
+      Budget.hotFields.push_back(F->name);
+  return Budget;
+}
+
+Error LayoutLinter::check(const FieldInfo &Record,
+                          std::vector<LintViolation> &Violations) const {
+  Expected<LayoutBudget> Budget = getBudget(Record);
+  if (!Budget)
+    return Budget.takeError();
+  if (Budget->empty())
+    return Error::success();
+
+  auto report = [&](StringRef Rule, uint64_t Limit, uint64_t Actual,
+                    const Twine &Message, StringRef Field = "") {
+    Violations.push_back({Record.type, Record.file, Record.line, Rule.str(),
+                          Field.str(), Limit, Actual, Message.str()});
+  };
+
+  uint64_t Size = Record.size.getQuantity();
+  uint64_t Align = Record.align.getQuantity();
+  if (Budget->maxSize && Size > *Budget->maxSize)
+    report("max_size", *Budget->maxSize, Size,
+           "size " + Twine(Size) + " exceeds " + Twine(*Budget->maxSize));
+  if (Budget->maxPadding) {
+    uint64_t Padding = getPaddingBytes(Record);
+    if (Padding > *Budget->maxPadding)
+      report("max_padding", *Budget->maxPadding, Padding,
+             Twine(Padding) + " bytes of padding exceed " +
+                 Twine(*Budget->maxPadding));
+  }
+  if (Budget->align && Align < *Budget->align)
+    report("align", *Budget->align, Align,
+           "alignment " + Twine(Align) + " is below " + Twine(*Budget->align));
+  if (Budget->cacheAligned && Align < CacheLine)
+    report("cache_aligned", CacheLine, Align,
+           "alignment " + Twine(Align) + " is below the cache line size " +
+               Twine(CacheLine));
+  if (Budget->noVPtr) {
+    auto IsVPtr = [](const FieldInfoPtr &F) {
+      return F && F->fieldType == FieldType::VPtr;
+    };
+    // A vptr of a primary base is shared with the record.
+    std::function<bool(const FieldInfo &)> HasVPtr = [&](const FieldInfo &R) {
+      return llvm::any_of(R.subFields, [&](const FieldInfoPtr &F) {
+        return IsVPtr(F) || (F && F->fieldType == FieldType::NVBase &&
+                             HasVPtr(*F));
+      });
+    };
+    if (HasVPtr(Record) || Record.hasVirtualBases)
+      report("no_vptr", 0, 1, "record is polymorphic or has virtual bases");
+  }
+
+  // Offsets are relative to the record, so which cache lines its fields
+  // fall on is only known if the record starts on one.
+  bool KnowsCacheLines = Align >= CacheLine;
+  if (!Budget->hotFields.empty() && !KnowsCacheLines)
+    report("hot_fields", CacheLine, Align,
+           "hot fields can't be checked: alignment " + Twine(Align) +
+               " is below the cache line size " + Twine(CacheLine));
+  StringSet<> Seen;
+  for (const std::string &Name : Budget->hotFields) {
+    if (!Seen.insert(Name).second)
+      continue;
+    auto It = llvm::find_if(Record.subFields, [&](const FieldInfoPtr &F) {
+      return F && F->name == Name;
+    });
+    if (It == Record.subFields.end()) {
+      report("hot_fields", 0, 0, "no field named '" + Name + "'", Name);
+      continue;
+    }
+    if (!KnowsCacheLines)
+      continue;
+    const FieldInfo &F = **It;
+    uint64_t Begin = F.offset >> 3;
+    uint64_t End = F.fieldType == FieldType::BitField
+                       ? (F.offset + F.bitWidth + 7) >> 3
+                       : Begin + F.size.getQuantity();
+    if (End > Begin && Begin / CacheLine != (End - 1) / CacheLine)
+      report("hot_fields", CacheLine, Begin % CacheLine,
+             "hot field '" + Name + "' at bytes [" + Twine(Begin) + ", " +
+                 Twine(End) + ") straddles a " + Twine(CacheLine) +
+                 "-byte cache line",
+             Name);
+  }
+  return Error::success();
+}
+
+void writeViolationsJson(raw_ostream &OS,
+                         const std::vector<LintViolation> &Violations) {
+  json::Array Out;
+  for (const LintViolation &V : Violations) {
+    json::Object O{{"record", V.record},
+                   {"rule", V.rule},
+                   {"limit", static_cast<int64_t>(V.limit)},
+                   {"actual", static_cast<int64_t>(V.actual)},
+                   {"message", V.message}};
+    if (!V.file.empty()) {
+      O["file"] = V.file;
+      O["line"] = V.line;
+    }
+    if (!V.field.empty())
+      O["field"] = V.field;
+    Out.push_back(std::move(O));
+  }
+  OS << json::Value(std::move(Out));
+}
+
+} // namespace cxxlayout
@@ -0,0 +1,84 @@
+#ifndef CXXLAYOUT_LAYOUTLINT_H
+#define CXXLAYOUT_LAYOUTLINT_H
+
+#include "CxxLayout.h"
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Regex.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cxxlayout {
+
+// Layout contract of a record. Written in source as
+//   struct [[clang::annotate("layout:max_size=64,no_vptr")]] Packet {
+//     [[clang::annotate("layout:hot")]] uint32_t seq;
+//   };
+// or in a lint config file (see LayoutLinter::fromConfig).
+struct LayoutBudget {
+  std::optional<uint64_t> maxSize;
+  std::optional<uint64_t> maxPadding;
+  std::optional<uint64_t> align; // minimum alignment
+  bool cacheAligned = false;     // align to at least a cache line
+  bool noVPtr = false;
+  // Must not straddle a cache line, which is only checked for records
+  // aligned to one.
+  std::vector<std::string> hotFields;
+
+  bool empty() const {
+    return !maxSize && !maxPadding && !align && !cacheAligned && !noVPtr &&
+           hotFields.empty();
+  }
+
+  // Parses a comma separated list of max_size=N, max_padding=N, align=N,
+  // cache_aligned and no_vptr into this budget, overriding what is set.
+  llvm::Error parse(llvm::StringRef Spec);
+};
+
+struct LintViolation {
+  std::string record;
+  std::string file;
+  unsigned line = 0;
+  std::string rule; // the budget key that was violated
+  std::string field; // for hot_fields
+  uint64_t limit = 0;
+  uint64_t actual = 0;
+  std::string message;
+};
+
+class LayoutLinter {
+  struct Rule {
+    llvm::Regex match; // searched for in qualified record names
+    LayoutBudget budget;
+  };
+  std::vector<Rule> Rules;
+  uint64_t CacheLine = 64;
+
+public:
+  // Reads rules from a JSON config:
+  //   {"cache_line": 64,
+  //    "rules": [{"match": "^net::", "max_size": 64, "max_padding": 8,
+  //               "align": 16, "cache_aligned": true, "no_vptr": true,
+  //               "hot_fields": ["seq", "len"]}]}
+  // Every rule whose regex is found anywhere in the qualified name of a
+  // record applies to it, later ones overriding earlier ones. Anchor the
+  // regex with ^ and $ to match whole names.
+  static llvm::Expected<LayoutLinter> fromConfig(llvm::StringRef Json);
+
+  // The budget of Record: the config rules matching it, then its own
+  // annotations and those of its fields.
+  llvm::Expected<LayoutBudget> getBudget(const FieldInfo &Record) const;
+
+  // Checks Record against its budget, appending what it violates.
+  llvm::Error check(const FieldInfo &Record,
+                    std::vector<LintViolation> &Violations) const;
+};
+
+void writeViolationsJson(llvm::raw_ostream &OS,
+                         const std::vector<LintViolation> &Violations);
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_LAYOUTLINT_H
@@ -0,0 +1,405 @@
+#include "RevisionDiff.h"
+#include "CxxLayout.h"
+
+#include "clang/Basic/Version.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace cxxlayout {
+
+static std::string hashContents(StringRef Data) {
+  return toHex(SHA256::hash(arrayRefFromStringRef(Data)), /*LowerCase=*/true);
+}
+
+// Bump when the cached records or deps change shape or meaning.
+static constexpr unsigned CACHE_SCHEMA_VERSION = 1;
+
+// Entries written by another build of the tool may describe the layouts
+// differently, so the clang version it was built from is part of the key.
+static std::string getCacheKey(StringRef Args, StringRef File,
+                               StringRef Contents) {
+  return hashContents((Twine(CACHE_SCHEMA_VERSION) + "\n" +
+                       clang::getClangFullVersion() + "\n" + Args + "\n" +
+                       File + "\n" + Contents)
+                          .str());
+}
+
+static std::optional<std::string> readFile(const Twine &Path) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (!Buffer)
+    return std::nullopt;
+  return (*Buffer)->getBuffer().str();
+}
+
+std::optional<json::Array> AnalysisCache::lookup(StringRef Args,
+                                                 StringRef File,
+                                                 StringRef Contents,
+                                                 StringRef Root) const {
+  SmallString<128> EntryPath(Dir);
+  sys::path::append(EntryPath, getCacheKey(Args, File, Contents) + ".json");
+  std::optional<std::string> Entry = readFile(EntryPath);
+  if (!Entry)
+    return std::nullopt;
+  Expected<json::Value> Parsed = json::parse(*Entry);
+  if (!Parsed) {
+    consumeError(Parsed.takeError());
+    return std::nullopt;
+  }
+  json::Object *Obj = Parsed->getAsObject();
+  const json::Array *Deps = Obj ? Obj->getArray("deps") : nullptr;
+  json::Array *Records = Obj ? Obj->getArray("records") : nullptr;
+  if (!Deps || !Records)
+    return std::nullopt;
+  for (const json::Value &V : *Deps) {
+    const json::Object *Dep = V.getAsObject();
+    if (!Dep)
+      return std::nullopt;
+    StringRef Path = Dep->getString("path").value_or("");
+    SmallString<128> FullPath;
+    if (Dep->getBoolean("tree").value_or(false))
+      sys::path::append(FullPath, Root, Path);
+    else
+      FullPath = Path;
+    std::optional<std::string> DepContents = readFile(FullPath);
+    if (!DepContents ||
+        hashContents(*DepContents) != Dep->getString("hash").value_or(""))
+      return std::nullopt;
+  }
+  return std::move(*Records);
+}
+
+void AnalysisCache::store(StringRef Args, StringRef File, StringRef Contents,
+                          StringRef Root, ArrayRef<std::string> Dependencies,
+                          const json::Array &Records) const {
+  json::Array Deps;
+  for (const std::string &Dependency : Dependencies) {
+    SmallString<128> Path(Dependency);
+    sys::fs::make_absolute(Path);
+    sys::path::remove_dots(Path, /*remove_dot_dot=*/true);
+    std::optional<std::string> DepContents = readFile(Path);
+    if (!DepContents)
+      return; // not a real file, the entry could never be validated
+    StringRef Relative = Path;
+    bool InTree = Relative.consume_front(Root) &&
+                  Relative.consume_front(sys::path::get_separator());
+    Deps.push_back(json::Object{{"path", InTree ? Relative : StringRef(Path)},
+                                {"tree", InTree},
+                                {"hash", hashContents(*DepContents)}});
+  }
+
+  if (sys::fs::create_directories(Dir))
+    return;
+  SmallString<128> EntryPath(Dir);
+  sys::path::append(EntryPath, getCacheKey(Args, File, Contents) + ".json");
+  // Written to the side first, so that concurrent runs never read half an
+  // entry.
+  SmallString<128> TempPath(EntryPath);
+  TempPath += ".tmp" + utostr(sys::Process::getProcessId());
+  {
+    std::error_code EC;
+    raw_fd_ostream OS(TempPath, EC);
+    if (EC)
+      return;
+    OS << json::Value(json::Object{{"deps", std::move(Deps)},
+                                   {"records", json::Array(Records)}});
+  }
+  if (sys::fs::rename(TempPath, EntryPath))
+    sys::fs::remove(TempPath);
+}
+
+// Runs git with Args and returns its trimmed standard output.
+static Expected<std::string> runGit(ArrayRef<StringRef> Args) {
+  static ErrorOr<std::string> Git = sys::findProgramByName("git");
+  if (!Git)
+    return createStringError(Git.getError(), "git not found");
+  SmallString<128> OutPath;
+  if (std::error_code EC =
+          sys::fs::createTemporaryFile("cxx-layout-git", "out", OutPath))
+    return createStringError(EC, "cannot create a temporary file");
+  auto RemoveOut = make_scope_exit([&] { sys::fs::remove(OutPath); });
+
+  std::vector<StringRef> Argv = {"git"};
+  llvm::append_range(Argv, Args);
+  std::optional<StringRef> Redirects[] = {StringRef(), StringRef(OutPath),
+                                          std::nullopt};
+  std::string ErrMsg;
+  int Result = sys::ExecuteAndWait(*Git, Argv, std::nullopt, Redirects, 0, 0,
+                                   &ErrMsg);
+  if (Result != 0)
+    return createStringError("git " + join(Args, " ") + " failed" +
+                             (ErrMsg.empty() ? "" : ": " + ErrMsg));
+  std::optional<std::string> Out = readFile(OutPath);
+  return Out ? StringRef(*Out).trim().str() : std::string();
+}
+
+// S without the occurrences of Prefix.
+static std::string removeAll(StringRef S, StringRef Prefix) {
+  std::string Result;
+  while (true) {
+    size_t Pos = S.find(Prefix);
+    Result += S.take_front(Pos);
+    if (Pos == StringRef::npos)
+      return Result;
+    S = S.drop_front(Pos + Prefix.size());
+  }
+}
+
+// {"name", "size", "align", "padding", "layout"} of a record. Anonymous
+// records are named after where they are, so the worktree Root is taken out
+// of the names to match them up across revisions.
+static json::Value getRecordJson(const FieldInfo &Info, StringRef Root) {
+  std::string Prefix = (Root + sys::path::get_separator()).str();
+  std::string EscapedPrefix;
+  raw_string_ostream EscapedOS(EscapedPrefix);
+  writeEscaped(EscapedOS, Prefix);
+  EscapedOS.flush();
+  std::string Layout;
+  raw_string_ostream OS(Layout);
+  writeFieldJson(OS, Info);
+  OS.flush();
+  Layout = removeAll(Layout, EscapedPrefix);
+  json::Value LayoutJson = json::Object{};
+  if (Expected<json::Value> Parsed = json::parse(Layout))
+    LayoutJson = std::move(*Parsed);
+  else
+    consumeError(Parsed.takeError());
+  return json::Object{{"name", removeAll(Info.type, Prefix)},
+                      {"size", Info.size.getQuantity()},
+                      {"align", Info.align.getQuantity()},
+                      {"padding", static_cast<int64_t>(getPaddingBytes(Info))},
+                      {"layout", std::move(LayoutJson)}};
+}
+
+Expected<RevisionLayouts> analyzeRevision(StringRef Rev,
+                                          ArrayRef<std::string> Files,
+                                          const AnalysisCache *Cache) {
+  RevisionLayouts Result;
+  Expected<std::string> Commit =
+      runGit({"rev-parse", "--verify", "--quiet", (Rev + "^{commit}").str()});
+  if (!Commit) {
+    consumeError(Commit.takeError());
+    return createStringError("unknown revision '" + Rev + "'");
+  }
+  Result.commit = *Commit;
+  Expected<std::string> Time =
+      runGit({"show", "-s", "--format=%ct", Result.commit});
+  if (!Time)
+    return Time.takeError();
+  StringRef(*Time).getAsInteger(10, Result.time);
+  Expected<std::string> Prefix = runGit({"rev-parse", "--show-prefix"});
+  if (!Prefix)
+    return Prefix.takeError();
+
+  SmallString<128> Root, RealRoot;
+  if (std::error_code EC =
+          sys::fs::createUniqueDirectory("cxx-layout-worktree", Root))
+    return createStringError(EC, "cannot create a worktree directory");
+  if (Expected<std::string> Added = runGit(
+          {"worktree", "add", "--detach", "--quiet", Root, Result.commit});
+      !Added) {
+    sys::fs::remove(Root);
+    return Added.takeError();
+  }
+  SmallString<128> OldCwd;
+  sys::fs::current_path(OldCwd);
+  auto Cleanup = make_scope_exit([&] {
+    sys::fs::set_current_path(OldCwd);
+    consumeError(
+        runGit({"worktree", "remove", "--force", Root}).takeError());
+  });
+  sys::fs::real_path(Root, RealRoot);
+  SmallString<128> Cwd(RealRoot);
+  sys::path::append(Cwd, *Prefix);
+  if (std::error_code EC = sys::fs::set_current_path(Cwd))
+    return createStringError(EC, "cannot enter " + Twine(Cwd));
+
+  LayoutContext &Ctx = getContext();
+  // Layouts depend on the data model as much as on the arguments, and the
+  // records on the filter and how types are printed.
+  std::string Args = Ctx.args;
+  if (Ctx.targetDescription)
+    Args += "\n" + Ctx.targetDescription->str();
+  Args += "\nfilter=" + Ctx.recordFilter;
+  Args += "\ntype-names=" + utostr(static_cast<unsigned>(Ctx.typeNameStyle));
+  if (Ctx.analyzeAccesses)
+    Args += "\naccesses";
+  for (const std::string &File : Files) {
+    std::optional<std::string> Contents = readFile(File);
+    if (!Contents)
+      continue; // not in this revision
+    std::optional<json::Array> Records;
+    if (Cache)
+      Records = Cache->lookup(Args, File, *Contents, RealRoot);
+    if (!Records) {
+      analyzeCode(*Contents, File);
+      Records.emplace();
+      for (const auto &R : Ctx.records)
+        Records->push_back(getRecordJson(*R.second, RealRoot));
+      if (Cache)
+        Cache->store(Args, File, *Contents, RealRoot, Ctx.includedFiles,
+                     *Records);
+    }
+    for (json::Value &Record : *Records) {
+      const json::Object *Obj = Record.getAsObject();
+      std::optional<StringRef> Name =
+          Obj ? Obj->getString("name") : std::nullopt;
+      if (Name && !Result.records.get(*Name))
+        Result.records.try_emplace(*Name, std::move(Record));
+    }
+  }
+  return Result;
+}
+
+static std::vector<std::string> getSortedNames(const json::Object &Obj) {
+  std::vector<std::string> Names;
+  for (const auto &KV : Obj)
+    Names.push_back(KV.first.str());
+  llvm::sort(Names);
+  return Names;
+}
+
+// Top-level fields of a record by name, bases by type, with their offsets.
+static StringMap<int64_t> getFieldOffsets(const json::Object &Record) {
+  StringMap<int64_t> Offsets;
+  const json::Object *Layout = Record.getObject("layout");
+  const json::Array *Fields = Layout ? Layout->getArray("subFields") : nullptr;
+  if (!Fields)
+    return Offsets;
+  for (const json::Value &V : *Fields) {
+    const json::Object *Field = V.getAsObject();
+    if (!Field || Field->getString("fieldType") == "VPtr")
+      continue;
+    std::optional<StringRef> Name = Field->getString("name");
+    if (!Name)
+      Name = Field->getString("type");
+    if (Name)
+      Offsets.try_emplace(*Name, Field->getInteger("offset").value_or(0));
+  }
+  return Offsets;
+}
+
+static json::Array getSortedKeys(const StringMap<int64_t> &Map,
+                                 const StringMap<int64_t> &Except) {
+  std::vector<std::string> Keys;
+  for (const auto &KV : Map)
+    if (!Except.count(KV.getKey()))
+      Keys.push_back(KV.getKey().str());
+  llvm::sort(Keys);
+  return json::Array(Keys);
+}
+
+json::Value diffLayouts(const RevisionLayouts &Base,
+                        const RevisionLayouts &Head) {
+  std::vector<std::string> Names = getSortedNames(Base.records);
+  for (const std::string &Name : getSortedNames(Head.records))
+    if (!Base.records.get(Name))
+      Names.push_back(Name);
+  llvm::sort(Names);
+
+  json::Array Changes;
+  for (const std::string &Name : Names) {
+    const json::Object *Old = Base.records.getObject(Name);
+    const json::Object *New = Head.records.getObject(Name);
+    if (!Old || !New) {
+      const json::Object *Present = Old ? Old : New;
+      Changes.push_back(
+          json::Object{{"name", Name},
+                       {"status", Old ? "removed" : "added"},
+                       {"size", Present->getInteger("size").value_or(0)}});
+      continue;
+    }
+
+    auto delta = [&](StringRef Key) {
+      return New->getInteger(Key).value_or(0) -
+             Old->getInteger(Key).value_or(0);
+    };
+    StringMap<int64_t> OldFields = getFieldOffsets(*Old);
+    StringMap<int64_t> NewFields = getFieldOffsets(*New);
+    json::Array Moved;
+    std::vector<std::string> Common;
+    for (const auto &KV : NewFields)
+      if (OldFields.count(KV.getKey()))
+        Common.push_back(KV.getKey().str());
+    llvm::sort(Common);
+    for (const std::string &Field : Common)
+      if (OldFields[Field] != NewFields[Field])
+        Moved.push_back(json::Object{{"name", Field},
+                                     {"from", OldFields[Field]},
+                                     {"to", NewFields[Field]}});
+    json::Array Added = getSortedKeys(NewFields, OldFields);
+    json::Array Removed = getSortedKeys(OldFields, NewFields);
+
+    int64_t SizeDelta = delta("size"), AlignDelta = delta("align"),
+            PaddingDelta = delta("padding");
+    if (!SizeDelta && !AlignDelta && !PaddingDelta && Moved.empty() &&
+        Added.empty() && Removed.empty())
+      continue;
+    Changes.push_back(json::Object{
+        {"name", Name},
+        {"status", "changed"},
+        {"size", New->getInteger("size").value_or(0)},
+        {"sizeDelta", SizeDelta},
+        {"alignDelta", AlignDelta},
+        {"paddingDelta", PaddingDelta},
+        {"movedFields", std::move(Moved)},
+        {"addedFields", std::move(Added)},
+        {"removedFields", std::move(Removed)},
+    });
+  }
+  return json::Object{{"base", Base.commit},
+                      {"head", Head.commit},
+                      {"records", std::move(Changes)}};
+}
+
+Error appendHistory(StringRef Path, const RevisionLayouts &Layouts) {
+  if (std::optional<std::string> History = readFile(Path)) {
+    SmallVector<StringRef> Lines;
+    StringRef(*History).split(Lines, '\n', -1, /*KeepEmpty=*/false);
+    for (StringRef Line : Lines) {
+      Expected<json::Value> Entry = json::parse(Line);
+      if (!Entry) {
+        consumeError(Entry.takeError());
+        continue;
+      }
+      const json::Object *Obj = Entry->getAsObject();
+      if (Obj && Obj->getString("commit") == Layouts.commit)
+        return Error::success();
+    }
+  }
+
+  StringRef Parent = sys::path::parent_path(Path);
+  if (!Parent.empty())
+    if (std::error_code EC = sys::fs::create_directories(Parent))
+      return createStringError(EC, "cannot create " + Parent);
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::OF_Append | sys::fs::OF_Text);
+  if (EC)
+    return createStringError(EC, "cannot open " + Path);
+  for (const std::string &Name : getSortedNames(Layouts.records)) {
+    const json::Object *Record = Layouts.records.getObject(Name);
+    OS << json::Value(json::Object{
+              {"commit", Layouts.commit},
+              {"time", Layouts.time},
+              {"record", Name},
+              {"size", Record->getInteger("size").value_or(0)},
+              {"align", Record->getInteger("align").value_or(0)},
+              {"padding", Record->getInteger("padding").value_or(0)},
+          })
+       << '\n';
+  }
+  return Error::success();
+}
+
+} // namespace cxxlayout
@@ -0,0 +1,67 @@
+#ifndef CXXLAYOUT_REVISIONDIFF_H
+#define CXXLAYOUT_REVISIONDIFF_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace cxxlayout {
+
+// Analysis results of translation units, kept on disk across runs. An entry
+// is found by the hash of the arguments, path and contents of its main file,
+// and only used if every other file it read still has the same contents.
+// Paths inside the analyzed tree are stored relative to its root, so that
+// entries carry over between checkouts of different revisions.
+class AnalysisCache {
+  std::string Dir;
+
+public:
+  explicit AnalysisCache(llvm::StringRef Dir) : Dir(Dir.str()) {}
+
+  // The records of the last analysis of File if it is still valid.
+  std::optional<llvm::json::Array> lookup(llvm::StringRef Args,
+                                          llvm::StringRef File,
+                                          llvm::StringRef Contents,
+                                          llvm::StringRef Root) const;
+
+  void store(llvm::StringRef Args, llvm::StringRef File,
+             llvm::StringRef Contents, llvm::StringRef Root,
+             llvm::ArrayRef<std::string> Dependencies,
+             const llvm::json::Array &Records) const;
+};
+
+struct RevisionLayouts {
+  std::string commit;
+  int64_t time = 0; // commit time, in seconds since the epoch
+  // {"name", "size", "align", "padding", "layout"} of every record, by
+  // qualified name; a record seen in several files is kept once.
+  llvm::json::Object records;
+};
+
+// Checks out Rev in a temporary worktree and analyzes Files there with the
+// current arguments. Files are relative to the current directory, which is
+// mirrored in the worktree, so relative include paths in the arguments keep
+// working.
+llvm::Expected<RevisionLayouts>
+analyzeRevision(llvm::StringRef Rev, llvm::ArrayRef<std::string> Files,
+                const AnalysisCache *Cache);
+
+// The records that differ between Base and Head: added and removed ones,
+// and size, alignment and padding deltas plus added, removed and moved
+// fields of the rest.
+llvm::json::Value diffLayouts(const RevisionLayouts &Base,
+                              const RevisionLayouts &Head);
+
+// Appends a line of {"commit", "time", "record", "size", "align",
+// "padding"} per record to the NDJSON file at Path, unless the commit is
+// already in it.
+llvm::Error appendHistory(llvm::StringRef Path,
+                          const RevisionLayouts &Layouts);
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_REVISIONDIFF_H
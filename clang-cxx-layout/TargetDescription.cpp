@@ -0,0 +1,217 @@
+#include "TargetDescription.h"
+
+#include "clang/Basic/TargetInfo.h"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace llvm;
+using TTI = clang::TransferrableTargetInfo;
+
+namespace cxxlayout {
+
+namespace {
+
+struct TypeFields {
+  const char *name;
+  unsigned char TTI::*width;
+  unsigned char TTI::*align;
+  const fltSemantics *TTI::*format; // null for non-floating types
+};
+
+const TypeFields TypeTable[] = {
+    {"bool", &TTI::BoolWidth, &TTI::BoolAlign, nullptr},
+    {"int", &TTI::IntWidth, &TTI::IntAlign, nullptr},
+    {"long", &TTI::LongWidth, &TTI::LongAlign, nullptr},
+    {"long_long", &TTI::LongLongWidth, &TTI::LongLongAlign, nullptr},
+    {"half", &TTI::HalfWidth, &TTI::HalfAlign, &TTI::HalfFormat},
+    {"float", &TTI::FloatWidth, &TTI::FloatAlign, &TTI::FloatFormat},
+    {"double", &TTI::DoubleWidth, &TTI::DoubleAlign, &TTI::DoubleFormat},
+    {"long_double", &TTI::LongDoubleWidth, &TTI::LongDoubleAlign,
+     &TTI::LongDoubleFormat},
+    {"pointer", &TTI::PointerWidth, &TTI::PointerAlign, nullptr},
+};
+
+const char *const IntTypeNames[] = {"size_type", "ptrdiff_type",
+                                    "intptr_type", "intmax_type",
+                                    "wchar_type"};
+
+// The data model part of TargetInfo. The typedef types and bitfield rules
+// are protected, so they are set on a copy of it in this subclass, which is
+// then assigned back.
+struct DataModel : TTI {
+  explicit DataModel(const TTI &Base) : TTI(Base) {}
+
+  IntType &intType(unsigned Index) {
+    switch (Index) {
+    case 0:
+      return SizeType;
+    case 1:
+      return PtrDiffType;
+    case 2:
+      return IntPtrType;
+    case 3:
+      return IntMaxType;
+    default:
+      return WCharType;
+    }
+  }
+  void setBitfieldTypeAlignment(bool B) { UseBitFieldTypeAlignment = B; }
+  void setZeroLengthBitfieldAlignment(bool B) {
+    UseZeroLengthBitfieldAlignment = B;
+  }
+  void setExplicitBitfieldAlignment(bool B) {
+    UseExplicitBitFieldAlignment = B;
+  }
+  void setZeroLengthBitfieldBoundary(unsigned Bits) {
+    ZeroLengthBitfieldBoundary = Bits;
+  }
+};
+
+} // namespace
+
+static std::optional<TTI::IntType> getIntType(StringRef Name) {
+  return StringSwitch<std::optional<TTI::IntType>>(Name)
+      .Case("signed char", TTI::SignedChar)
+      .Case("unsigned char", TTI::UnsignedChar)
+      .Case("short", TTI::SignedShort)
+      .Case("unsigned short", TTI::UnsignedShort)
+      .Case("int", TTI::SignedInt)
+      .Case("unsigned int", TTI::UnsignedInt)
+      .Case("long", TTI::SignedLong)
+      .Case("unsigned long", TTI::UnsignedLong)
+      .Case("long long", TTI::SignedLongLong)
+      .Case("unsigned long long", TTI::UnsignedLongLong)
+      .Default(std::nullopt);
+}
+
+static const fltSemantics *getFloatFormat(StringRef Name) {
+  return StringSwitch<const fltSemantics *>(Name)
+      .Case("ieee-half", &APFloat::IEEEhalf())
+      .Case("ieee-single", &APFloat::IEEEsingle())
+      .Case("ieee-double", &APFloat::IEEEdouble())
+      .Case("x87", &APFloat::x87DoubleExtended())
+      .Case("ieee-quad", &APFloat::IEEEquad())
+      .Case("ppc-double-double", &APFloat::PPCDoubleDouble())
+      .Default(nullptr);
+}
+
+// TargetInfo keeps widths and alignments in an unsigned char.
+static Expected<unsigned> getBits(const json::Value &V, const Twine &Key,
+                                  bool PowerOf2) {
+  std::optional<int64_t> N = V.getAsInteger();
+  if (!N || *N < 8 || *N > 128 || *N % 8 != 0 ||
+      (PowerOf2 && !isPowerOf2_64(*N)))
+    return createStringError(
+        Key + " must be " + (PowerOf2 ? "a power of two" : "a multiple of 8") +
+        " from 8 to 128 bits");
+  return static_cast<unsigned>(*N);
+}
+
+Expected<TargetDescription> TargetDescription::parse(StringRef Json) {
+  Expected<json::Value> Value = json::parse(Json);
+  if (!Value)
+    return Value.takeError();
+  const json::Object *Root = Value->getAsObject();
+  if (!Root)
+    return createStringError("target description must be a JSON object");
+
+  TargetDescription D;
+  D.Json = Json.str();
+  for (const auto &[Key, V] : *Root) {
+    StringRef Name = Key;
+    const auto *Type = llvm::find_if(
+        TypeTable, [&](const TypeFields &T) { return Name == T.name; });
+    if (Type != std::end(TypeTable)) {
+      const json::Object *Fields = V.getAsObject();
+      if (!Fields)
+        return createStringError(Name + " must be an object");
+      TypeOverride Override{
+          static_cast<unsigned>(Type - std::begin(TypeTable)), {}, {}, {}};
+      for (const auto &[FieldKey, FieldValue] : *Fields) {
+        StringRef Field = FieldKey;
+        if (Field == "width" || Field == "align") {
+          Expected<unsigned> Bits =
+              getBits(FieldValue, Name + "." + Field, Field == "align");
+          if (!Bits)
+            return Bits.takeError();
+          (Field == "width" ? Override.width : Override.align) = *Bits;
+        } else if (Field == "format" && Type->format) {
+          std::optional<StringRef> Format = FieldValue.getAsString();
+          Override.format = Format ? getFloatFormat(*Format) : nullptr;
+          if (!Override.format)
+            return createStringError("unknown " + Name + ".format");
+        } else {
+          return createStringError("unknown target description key '" +
+                                   Name + "." + Field + "'");
+        }
+      }
+      D.Types.push_back(Override);
+      continue;
+    }
+
+    const auto *IntTypeName = llvm::find(IntTypeNames, Name);
+    if (IntTypeName != std::end(IntTypeNames)) {
+      std::optional<StringRef> S = V.getAsString();
+      std::optional<TTI::IntType> IT = S ? getIntType(*S) : std::nullopt;
+      if (!IT)
+        return createStringError(Name + " must name an integer type, like "
+                                        "\"unsigned int\"");
+      D.IntTypes.emplace_back(IntTypeName - std::begin(IntTypeNames), *IT);
+      continue;
+    }
+
+    std::optional<bool> *Flag =
+        StringSwitch<std::optional<bool> *>(Name)
+            .Case("bitfield_type_alignment", &D.BitfieldTypeAlignment)
+            .Case("zero_length_bitfield_alignment",
+                  &D.ZeroLengthBitfieldAlignment)
+            .Case("explicit_bitfield_alignment", &D.ExplicitBitfieldAlignment)
+            .Default(nullptr);
+    if (Flag) {
+      *Flag = V.getAsBoolean();
+      if (!*Flag)
+        return createStringError(Name + " must be true or false");
+      continue;
+    }
+
+    if (Name == "zero_length_bitfield_boundary") {
+      Expected<unsigned> Bits = getBits(V, Name, /*PowerOf2=*/true);
+      if (!Bits)
+        return Bits.takeError();
+      D.ZeroLengthBitfieldBoundary = *Bits;
+      continue;
+    }
+    return createStringError("unknown target description key '" + Name +
+                             "'");
+  }
+  return D;
+}
+
+void TargetDescription::apply(clang::TargetInfo &Target) const {
+  DataModel Model(Target);
+  for (const TypeOverride &O : Types) {
+    const TypeFields &T = TypeTable[O.type];
+    if (O.width)
+      Model.*T.width = *O.width;
+    if (O.align)
+      Model.*T.align = *O.align;
+    if (O.format)
+      Model.*T.format = O.format;
+  }
+  for (auto [Field, Type] : IntTypes)
+    Model.intType(Field) = static_cast<TTI::IntType>(Type);
+  if (BitfieldTypeAlignment)
+    Model.setBitfieldTypeAlignment(*BitfieldTypeAlignment);
+  if (ZeroLengthBitfieldAlignment)
+    Model.setZeroLengthBitfieldAlignment(*ZeroLengthBitfieldAlignment);
+  if (ExplicitBitfieldAlignment)
+    Model.setExplicitBitfieldAlignment(*ExplicitBitfieldAlignment);
+  if (ZeroLengthBitfieldBoundary)
+    Model.setZeroLengthBitfieldBoundary(*ZeroLengthBitfieldBoundary);
+  static_cast<TTI &>(Target) = Model;
+}
+
+} // namespace cxxlayout
@@ -0,0 +1,63 @@
+#ifndef CXXLAYOUT_TARGETDESCRIPTION_H
+#define CXXLAYOUT_TARGETDESCRIPTION_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang {
+class TargetInfo;
+} // namespace clang
+
+namespace llvm {
+struct fltSemantics;
+} // namespace llvm
+
+namespace cxxlayout {
+
+// Changes to the data model of the target clang set up from the arguments,
+// for targets whose type sizes and layout rules --target alone doesn't
+// give. Written as JSON, with widths and alignments in bits:
+//   {"int": {"width": 16, "align": 16},
+//    "pointer": {"width": 16, "align": 16},
+//    "long_double": {"width": 32, "align": 32, "format": "ieee-single"},
+//    "size_type": "unsigned int",
+//    "bitfield_type_alignment": false}
+// Types are bool, int, long, long_long, half, float, double, long_double and
+// pointer; float types also take a format of ieee-half, ieee-single,
+// ieee-double, x87, ieee-quad or ppc-double-double. size_type,
+// ptrdiff_type, intptr_type, intmax_type and wchar_type name an integer
+// type. The other keys are the bitfield_type_alignment,
+// zero_length_bitfield_alignment and explicit_bitfield_alignment flags, and
+// zero_length_bitfield_boundary in bits.
+class TargetDescription {
+  struct TypeOverride {
+    unsigned type; // index into the table of types in the .cpp
+    std::optional<unsigned> width;
+    std::optional<unsigned> align;
+    const llvm::fltSemantics *format = nullptr;
+  };
+  std::vector<TypeOverride> Types;
+  std::vector<std::pair<unsigned, unsigned>> IntTypes; // field, IntType
+  std::optional<bool> BitfieldTypeAlignment;
+  std::optional<bool> ZeroLengthBitfieldAlignment;
+  std::optional<bool> ExplicitBitfieldAlignment;
+  std::optional<unsigned> ZeroLengthBitfieldBoundary;
+  std::string Json; // as given, for cache keys
+
+public:
+  static llvm::Expected<TargetDescription> parse(llvm::StringRef Json);
+
+  // Meant to run before the preprocessor and AST are created, so that
+  // predefined macros such as __SIZEOF_INT__ agree with the layouts.
+  void apply(clang::TargetInfo &Target) const;
+
+  const std::string &str() const { return Json; }
+};
+
+} // namespace cxxlayout
+
+#endif // CXXLAYOUT_TARGETDESCRIPTION_H
@@ -0,0 +1,72 @@
+#!/usr/bin/env node
+// Packs header directories into a single archive for the wasm build.
+//
+//   node scripts/pack-headers.mjs <out-prefix> <dir>=<mount> [<dir>=<mount>...]
+//
+// e.g.
+//   node scripts/pack-headers.mjs wasm/headers \
+//       $LIBCXX/include/c++/v1=/sysroot/include/c++/v1 \
+//       $CLANG/lib/clang/20/include=/sysroot/lib/clang/include \
+//       $LIBC/include=/sysroot/include
+//
+// writes <out-prefix>.pack, the concatenated header contents, and
+// <out-prefix>.json, the index the playground uses to create lazy files.
+// The index lists each file's byte range in the pack, so a header is only
+// fetched when clang opens it. Mounts are searched in the order given.
+
+import fs from 'node:fs';
+import path from 'node:path';
+import crypto from 'node:crypto';
+
+function usage() {
+    console.error('usage: pack-headers.mjs <out-prefix> <dir>=<mount> [<dir>=<mount>...]');
+    process.exit(1);
+}
+
+function* walk(dir) {
+    for (const entry of fs.readdirSync(dir, { withFileTypes: true }).sort((a, b) => a.name.localeCompare(b.name))) {
+        const full = path.join(dir, entry.name);
+        if (entry.isDirectory()) {
+            yield* walk(full);
+        } else if (entry.isFile() || entry.isSymbolicLink()) {
+            yield full;
+        }
+    }
+}
+
+const [outPrefix, ...mounts] = process.argv.slice(2);
+if (!outPrefix || mounts.length === 0) usage();
+
+const files = {};
+const chunks = [];
+const includeDirs = [];
+let offset = 0;
+
+for (const mapping of mounts) {
+    const sep = mapping.lastIndexOf('=');
+    if (sep <= 0) usage();
+    const dir = mapping.slice(0, sep);
+    const mount = mapping.slice(sep + 1).replace(/\/+$/, '');
+    includeDirs.push(mount);
+    for (const file of walk(dir)) {
+        const target = `${mount}/${path.relative(dir, file).split(path.sep).join('/')}`;
+        if (target in files) continue;
+        const data = fs.readFileSync(file);
+        files[target] = [offset, data.length];
+        chunks.push(data);
+        offset += data.length;
+    }
+}
+
+const pack = Buffer.concat(chunks);
+const index = {
+    version: crypto.createHash('sha256').update(pack).digest('hex').slice(0, 16),
+    size: pack.length,
+    args: ['-nostdinc', ...includeDirs.flatMap(dir => ['-isystem', dir])].join(' '),
+    files,
+};
+
+fs.mkdirSync(path.dirname(outPrefix), { recursive: true });
+fs.writeFileSync(`${outPrefix}.pack`, pack);
+fs.writeFileSync(`${outPrefix}.json`, JSON.stringify(index));
+console.log(`${Object.keys(files).length} headers, ${pack.length} bytes -> ${outPrefix}.pack`);
@@ -0,0 +1,168 @@
+interface CacheEntry<T> {
+    key: string;
+    value: T;
+    size: number;
+    lastUsed: number;
+}
+
+// Results go in one store, their sizes and last use in another, so that
+// eviction never has to read the results themselves.
+const STORE = 'results';
+const SIZES = 'sizes';
+
+interface SizeEntry {
+    key: string;
+    size: number;
+    lastUsed: number;
+}
+
+function requestToPromise<R>(request: IDBRequest<R>): Promise<R> {
+    return new Promise((resolve, reject) => {
+        request.onsuccess = () => resolve(request.result);
+        request.onerror = () => reject(request.error);
+    });
+}
+
+/**
+ * Two-level LRU cache of analysis results: an in-memory map in front of an
+ * IndexedDB store that survives reloads. Each level evicts its least
+ * recently used entries once the JSON size of its contents exceeds its cap.
+ * The store is emptied whenever `version` changes, so results of an older
+ * engine build aren't served after a deploy.
+ */
+export class ResultCache<T> {
+    private memory: Map<string, CacheEntry<T>> = new Map();
+    private memoryBytes: number = 0;
+    private memoryCap: number;
+    private persistentCap: number;
+    private db: Promise<IDBDatabase | null>;
+
+    constructor(name: string, version: number, memoryCap: number, persistentCap: number) {
+        this.memoryCap = memoryCap;
+        this.persistentCap = persistentCap;
+        this.db = this.openDatabase(name, version);
+    }
+
+    static async key(...parts: string[]): Promise<string> {
+        const data = new TextEncoder().encode(parts.join('\0'));
+        if (globalThis.crypto?.subtle) {
+            const digest = await crypto.subtle.digest('SHA-256', data);
+            return Array.from(new Uint8Array(digest), b => b.toString(16).padStart(2, '0')).join('');
+        }
+        // crypto.subtle is missing outside secure contexts; fall back to a
+        // pair of FNV-1a hashes with different offsets.
+        let h1 = 0x811c9dc5, h2 = 0x01000193 ^ data.length;
+        for (const b of data) {
+            h1 = Math.imul(h1 ^ b, 0x01000193);
+            h2 = Math.imul(h2 ^ b, 0x01000193) ^ (h1 >>> 15);
+        }
+        return (h1 >>> 0).toString(16).padStart(8, '0') + (h2 >>> 0).toString(16).padStart(8, '0');
+    }
+
+    async get(key: string): Promise<T | undefined> {
+        const hit = this.memory.get(key);
+        if (hit) {
+            this.memory.delete(key);
+            hit.lastUsed = Date.now();
+            this.memory.set(key, hit);
+            return hit.value;
+        }
+
+        const db = await this.db;
+        if (!db) return undefined;
+        try {
+            const transaction = db.transaction([STORE, SIZES], 'readwrite');
+            const sizes = transaction.objectStore(SIZES);
+            const stored = await requestToPromise(transaction.objectStore(STORE).get(key)) as
+                { key: string; value: T } | undefined;
+            const size = await requestToPromise(sizes.get(key)) as SizeEntry | undefined;
+            if (!stored || !size) return undefined;
+            size.lastUsed = Date.now();
+            sizes.put(size);
+            this.remember({ key, value: stored.value, size: size.size, lastUsed: size.lastUsed });
+            return stored.value;
+        } catch (err) {
+            console.warn('Result cache lookup failed:', err);
+            return undefined;
+        }
+    }
+
+    async put(key: string, value: T): Promise<void> {
+        const entry: CacheEntry<T> = { key, value, size: JSON.stringify(value).length, lastUsed: Date.now() };
+        this.remember(entry);
+
+        const db = await this.db;
+        if (!db || entry.size > this.persistentCap) return;
+        try {
+            const transaction = db.transaction([STORE, SIZES], 'readwrite');
+            transaction.objectStore(STORE).put({ key, value });
+            await requestToPromise(transaction.objectStore(SIZES).put(
+                { key, size: entry.size, lastUsed: entry.lastUsed } as SizeEntry));
+            await this.evictPersistent(db);
+        } catch (err) {
+            console.warn('Result cache store failed:', err);
+        }
+    }
+
+    private remember(entry: CacheEntry<T>): void {
+        const previous = this.memory.get(entry.key);
+        if (previous) {
+            this.memoryBytes -= previous.size;
+            this.memory.delete(entry.key);
+        }
+        if (entry.size > this.memoryCap) return;
+        this.memory.set(entry.key, entry);
+        this.memoryBytes += entry.size;
+        // Map iteration follows insertion order, so the first key is the
+        // least recently used one.
+        for (const [oldKey, old] of this.memory) {
+            if (this.memoryBytes <= this.memoryCap) break;
+            this.memory.delete(oldKey);
+            this.memoryBytes -= old.size;
+        }
+    }
+
+    // Sums the sizes, which other tabs may have changed too, and walks
+    // entries from least recently used only when over the cap.
+    private async evictPersistent(db: IDBDatabase): Promise<void> {
+        const transaction = db.transaction([STORE, SIZES], 'readwrite');
+        const results = transaction.objectStore(STORE);
+        const sizes = transaction.objectStore(SIZES);
+        const entries = await requestToPromise(sizes.getAll()) as SizeEntry[];
+        let total = entries.reduce((sum, e) => sum + e.size, 0);
+        if (total <= this.persistentCap) return;
+        await new Promise<void>((resolve, reject) => {
+            const request = sizes.index('lastUsed').openCursor();
+            request.onerror = () => reject(request.error);
+            request.onsuccess = () => {
+                const cursor = request.result;
+                if (!cursor || total <= this.persistentCap) {
+                    resolve();
+                    return;
+                }
+                const entry = cursor.value as SizeEntry;
+                results.delete(entry.key);
+                cursor.delete();
+                total -= entry.size;
+                cursor.continue();
+            };
+        });
+    }
+
+    private openDatabase(name: string, version: number): Promise<IDBDatabase | null> {
+        if (typeof indexedDB === 'undefined') return Promise.resolve(null);
+        const request = indexedDB.open(name, version);
+        request.onupgradeneeded = () => {
+            const db = request.result;
+            for (const store of Array.from(db.objectStoreNames)) {
+                db.deleteObjectStore(store);
+            }
+            db.createObjectStore(STORE, { keyPath: 'key' });
+            db.createObjectStore(SIZES, { keyPath: 'key' }).createIndex('lastUsed', 'lastUsed');
+        };
+        return requestToPromise(request).catch(err => {
+            console.warn('Result cache is memory-only:', err);
+            return null;
+        });
+    }
+}
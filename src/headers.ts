@@ -0,0 +1,131 @@
+import { CxxLayoutModule } from '../wasm/clang-cxx-layout.js';
+
+// Index written next to the pack by scripts/pack-headers.mjs.
+interface HeaderIndex {
+    version: string;
+    size: number;
+    args: string;
+    files: Record<string, [number, number]>;
+}
+
+// The MEMFS node fields a lazy header hooks into: MEMFS stats `usedBytes`
+// and reads from `contents`, so turning both into getters defers the fetch
+// until clang actually reads the header.
+interface MemfsNode {
+    contents: Uint8Array | null;
+    usedBytes: number;
+}
+
+/**
+ * Standard library headers served from a separate archive. Mounting only
+ * fetches the index and creates empty placeholder files, so the core
+ * module's load size is unaffected. Before the first analysis that includes
+ * a header, `preload` fetches the pack without blocking; reads clang makes
+ * before that fall back to a synchronous range request per header.
+ */
+export class HeaderArchive {
+    readonly index: HeaderIndex;
+    private packUrl: string;
+    private pack: Uint8Array | null = null;
+    private preloading: Promise<void> | null = null;
+    private directories: Set<string> = new Set();
+
+    private constructor(index: HeaderIndex, packUrl: string) {
+        this.index = index;
+        this.packUrl = packUrl;
+    }
+
+    static async mount(module: CxxLayoutModule, baseUrl: URL): Promise<HeaderArchive> {
+        if (!module.FS) {
+            throw new Error('the engine was built without a file system');
+        }
+        const response = await fetch(new URL('headers.json', baseUrl));
+        if (!response.ok) {
+            throw new Error(`${response.status} ${response.statusText}`);
+        }
+        const index = await response.json() as HeaderIndex;
+        const packUrl = new URL(`headers.pack?v=${index.version}`, baseUrl).href;
+        const archive = new HeaderArchive(index, packUrl);
+        for (const [path, [offset, size]] of Object.entries(index.files)) {
+            archive.createLazyFile(module, path, offset, size);
+        }
+        return archive;
+    }
+
+    // Fetches the whole pack at once, since `#include <vector>` alone reads
+    // hundreds of headers and each synchronous read blocks the page. A
+    // failed fetch is retried by the next call.
+    preload(): Promise<void> {
+        this.preloading ??= fetch(this.packUrl)
+            .then(response => {
+                if (!response.ok) {
+                    throw new Error(`${response.status} ${response.statusText}`);
+                }
+                return response.arrayBuffer();
+            })
+            .then(buffer => {
+                this.pack ??= new Uint8Array(buffer);
+            })
+            .catch(err => {
+                this.preloading = null;
+                throw err;
+            });
+        return this.preloading;
+    }
+
+    private createLazyFile(module: CxxLayoutModule, path: string, offset: number, size: number): void {
+        const fs = module.FS!;
+        const slash = path.lastIndexOf('/');
+        const dir = path.slice(0, slash);
+        if (!this.directories.has(dir)) {
+            fs.mkdirTree(dir);
+            this.directories.add(dir);
+        }
+        fs.createDataFile(dir, path.slice(slash + 1), new Uint8Array(0), true, false, false);
+
+        const node = fs.lookupPath(path, {}).node as unknown as MemfsNode;
+        let contents: Uint8Array | null = null;
+        Object.defineProperties(node, {
+            usedBytes: { get: () => size },
+            contents: {
+                get: () => (contents ??= this.read(offset, size)),
+                set: (value: Uint8Array | null) => {
+                    contents = value;
+                },
+            },
+        });
+    }
+
+    // Called from inside a wasm file read, so this has to be synchronous.
+    // Synchronous XHR only allows text responses on the main thread; the
+    // x-user-defined charset maps every byte to one char code.
+    private read(offset: number, size: number): Uint8Array {
+        if (this.pack) {
+            return this.pack.subarray(offset, offset + size);
+        }
+        if (size === 0) {
+            return new Uint8Array(0);
+        }
+
+        const xhr = new XMLHttpRequest();
+        xhr.open('GET', this.packUrl, false);
+        xhr.overrideMimeType('text/plain; charset=x-user-defined');
+        xhr.setRequestHeader('Range', `bytes=${offset}-${offset + size - 1}`);
+        xhr.send(null);
+        if (xhr.status !== 200 && xhr.status !== 206) {
+            throw new Error(`Couldn't load ${this.packUrl}. Status: ${xhr.status}`);
+        }
+
+        const text = xhr.responseText;
+        const bytes = new Uint8Array(text.length);
+        for (let i = 0; i < text.length; i++) {
+            bytes[i] = text.charCodeAt(i) & 0xff;
+        }
+        if (xhr.status === 200) {
+            // The server ignored the range; keep the whole pack around.
+            this.pack = bytes;
+            return bytes.subarray(offset, offset + size);
+        }
+        return bytes;
+    }
+}
@@ -1,20 +1,41 @@
 import CxxLayout, { CxxLayoutModule } from '../wasm/clang-cxx-layout.js';
+import { HeaderArchive } from './headers.js';
+import { ResultCache } from './cache.js';
+import { calibrate, layoutFields, paddingBytes } from './layout.js';
 
 interface RecordInfo {
     id: string;
     name: string;
+    file?: string;
+    line?: number;
 }
 
 interface FieldLayout {
-    fieldType: 'Simple' | 'Record' | 'VPtr' | 'NVBase';
+    fieldType: 'Simple' | 'Record' | 'BitField' | 'VPtr' | 'NVBase';
     name?: string;
     type: string;
     size: number;
     align: number;
+    // Alignment the data member is laid out with, from newer engines
+    fieldAlign?: number;
     offset: number;
+    bitWidth?: number;
+    range?: [number, number];
     subFields?: FieldLayout[];
 }
 
+interface TimeTraceEntry {
+    kind: string;
+    name: string;
+    dur: number;
+}
+
+interface TimeTraceSummary {
+    total: number;
+    headers: TimeTraceEntry[];
+    instantiations: TimeTraceEntry[];
+}
+
 interface RecordLayout {
     fieldType: 'Record';
     type: string;
@@ -24,35 +45,218 @@ interface RecordLayout {
     subFields: FieldLayout[];
 }
 
+interface SummaryEntry {
+    id: string;
+    name: string;
+    size: number;
+    padding: number;
+    embedded: number;
+}
+
+interface LayoutSummary {
+    records: number;
+    totalBytes: number;
+    paddingBytes: number;
+    largest: SummaryEntry[];
+    worstPadding: SummaryEntry[];
+    mostEmbedded: SummaryEntry[];
+    histogram: { max: number; count: number }[];
+}
+
+type SummaryList = 'largest' | 'worstPadding' | 'mostEmbedded';
+type SummaryColumn = 'name' | 'size' | 'padding' | 'paddingRatio' | 'embedded';
+
+interface AnalysisResult {
+    records: RecordInfo[];
+    layouts: [string, RecordLayout][];
+    stderr: string;
+    summary?: LayoutSummary;
+}
+
+// One side of a comparison, with the key of what it was analyzed from
+interface DiffSide {
+    key: string;
+    result: AnalysisResult;
+}
+
+// Field statuses in a comparison, from B's point of view
+type FieldDiff = 'added' | 'removed' | 'moved' | 'resized' | null;
+
+const isDataMember = (field: FieldLayout): boolean =>
+    field.fieldType === 'Simple' || field.fieldType === 'Record' || field.fieldType === 'BitField';
+
+// Rendered elements by a key that is stable across analyses, with a
+// signature of what they were rendered from
+type KeyedElements = Map<string, { signature: string; element: HTMLElement }>;
+
+interface KeyedEntry {
+    key: string;
+    signature: string;
+    create: () => HTMLElement;
+}
+
+// Makes `container` hold the elements of `entries`, in order. Elements
+// whose signature did not change are kept where they are, so re-rendering
+// a nearly identical analysis only rebuilds what differs. `cache` may hold
+// elements that are not currently shown.
+const reconcile = (container: HTMLElement, cache: KeyedElements, entries: KeyedEntry[]): void => {
+    const wanted = new Set<Node>();
+    for (const { key, signature, create } of entries) {
+        let entry = cache.get(key);
+        if (entry?.signature !== signature) {
+            entry?.element.remove();
+            entry = { signature, element: create() };
+            cache.set(key, entry);
+        }
+        wanted.add(entry.element);
+    }
+    Array.from(container.childNodes).forEach(node => {
+        if (!wanted.has(node)) node.remove();
+    });
+    let cursor = container.firstChild;
+    for (const { key } of entries) {
+        const element = cache.get(key)!.element;
+        if (element === cursor) {
+            cursor = cursor.nextSibling;
+        } else {
+            container.insertBefore(element, cursor);
+        }
+    }
+};
+
+// Source ranges are not rendered and move with every edit above a record,
+// so they are left out of signatures.
+const layoutSignature = (value: unknown): string =>
+    JSON.stringify(value, (name, v) => name === 'range' ? undefined : v);
+
+const pruneKeyed = (cache: KeyedElements, keep: (key: string) => boolean): void => {
+    for (const key of [...cache.keys()]) {
+        if (!keep(key)) cache.delete(key);
+    }
+};
+
+// Engine record ids are declaration numbers and shift with any edit above a
+// record. Keys by qualified name, numbering repeated names in order, survive
+// those edits.
+const keyRecords = (records: RecordInfo[]): Map<string, string> => {
+    const keys = new Map<string, string>();
+    const seen = new Map<string, number>();
+    for (const record of records) {
+        const name = record.name || '<anonymous>';
+        const n = seen.get(name) ?? 0;
+        seen.set(name, n + 1);
+        keys.set(record.id, n === 0 ? name : `${name}#${n + 1}`);
+    }
+    return keys;
+};
+
+const RESULT_CACHE_MEMORY_CAP = 16 * 1024 * 1024;
+const RESULT_CACHE_PERSISTENT_CAP = 64 * 1024 * 1024;
+// Cached results are dropped when this changes. Bump it together with
+// CACHE_VERSION in sw.js whenever the engine is rebuilt.
+const ENGINE_VERSION = 3;
+const DIFF_REANALYZE_DELAY = 500; // ms after the last edit
+// Longest wait for an idle period before warming the engine up anyway, and
+// the delay used where requestIdleCallback is missing
+const WARM_UP_TIMEOUT = 2000; // ms
+
+const SUMMARY_LISTS: [SummaryList, string][] = [
+    ['largest', 'Largest'],
+    ['worstPadding', 'Most padding'],
+    ['mostEmbedded', 'Most embedded'],
+];
+const SUMMARY_COLUMNS: [SummaryColumn, string][] = [
+    ['name', 'Record'],
+    ['size', 'Size'],
+    ['padding', 'Padding'],
+    ['paddingRatio', 'Pad %'],
+    ['embedded', 'Embedded'],
+];
+
+// null for an invalid filter, which the engine ignores as well.
+const compileFilter = (filter: string): RegExp | null => {
+    try {
+        return new RegExp(filter);
+    } catch {
+        return null;
+    }
+};
+
+const paddingRatio = (entry: SummaryEntry): number => entry.size > 0 ? entry.padding / entry.size : 0;
+
 class CxxLayoutVisualizer {
     private module: CxxLayoutModule | null = null;
     private records: RecordInfo[] = [];
     private layouts: Map<string, RecordLayout> = new Map();
+    private cache: ResultCache<AnalysisResult> =
+        new ResultCache('cxxlayout-results', ENGINE_VERSION, RESULT_CACHE_MEMORY_CAP,
+            RESULT_CACHE_PERSISTENT_CAP);
 
     private codeEditor: HTMLTextAreaElement;
     private analyzeBtn: HTMLButtonElement;
     private targetSelect: HTMLSelectElement;
+    private recordFilter: HTMLInputElement;
+    private pruneToggle: HTMLInputElement;
+    private timeTraceToggle: HTMLInputElement;
+    private diffToggle: HTMLInputElement;
+    private diffInputs: HTMLElement;
+    private codeEditorB: HTMLTextAreaElement;
+    private targetSelectB: HTMLSelectElement;
     private loading: HTMLElement;
     private error: HTMLElement;
     private recordList: HTMLElement;
+    private summaryPanel: HTMLElement;
     private layoutVisualization: HTMLElement;
     private infoPanel: HTMLElement;
     private infoContent: HTMLElement;
     private clearInfoBtn: HTMLElement;
+    private exportTraceBtn: HTMLElement;
 
     private stderr: string = '';
+    private timeTrace: string | null = null;
+    private pruneEnabled: boolean = false;
+    private headers: Promise<HeaderArchive | null> | null = null;
+    private firstAnalysisDone: boolean = false;
+    private cancelWarmUp: () => void = () => {};
+    // What the displayed layouts were computed from, for re-analyses
+    private analyzed: { source: string; args: string; filter: string } | null = null;
+    // Reordered previews of records, by record id
+    private whatIf: Map<string, RecordLayout> = new Map();
+    private recordKeys: Map<string, string> = new Map(); // by engine id
+    private recordsByKey: Map<string, RecordInfo> = new Map();
+    private selectedKey: string | null = null; // null shows all records
+    private recordElements: KeyedElements = new Map();
+    private recordItems: KeyedElements = new Map();
+    private dragging: { key: string; index: number } | null = null;
+    // Comparison mode: the last analysis of each side, and the rendered
+    // record pairs by qualified name with what they were rendered from
+    private diffSides: [DiffSide | null, DiffSide | null] = [null, null];
+    private diffElements: KeyedElements = new Map();
+    private diffTimer: number | undefined;
+    private summary: LayoutSummary | null = null;
+    private summaryList: SummaryList = 'largest';
+    private summarySort: { column: SummaryColumn | null; descending: boolean } = { column: null, descending: true };
 
     constructor() {
         this.codeEditor = document.getElementById('codeEditor') as HTMLTextAreaElement;
         this.analyzeBtn = document.getElementById('analyzeBtn') as HTMLButtonElement;
         this.targetSelect = document.getElementById('targetSelect') as HTMLSelectElement;
+        this.recordFilter = document.getElementById('recordFilter') as HTMLInputElement;
+        this.pruneToggle = document.getElementById('pruneToggle') as HTMLInputElement;
+        this.timeTraceToggle = document.getElementById('timeTraceToggle') as HTMLInputElement;
+        this.diffToggle = document.getElementById('diffToggle') as HTMLInputElement;
+        this.diffInputs = document.getElementById('diffInputs') as HTMLElement;
+        this.codeEditorB = document.getElementById('codeEditorB') as HTMLTextAreaElement;
+        this.targetSelectB = document.getElementById('targetSelectB') as HTMLSelectElement;
         this.loading = document.getElementById('loading') as HTMLElement;
         this.error = document.getElementById('error') as HTMLElement;
         this.recordList = document.getElementById('recordList') as HTMLElement;
+        this.summaryPanel = document.getElementById('summaryPanel') as HTMLElement;
         this.layoutVisualization = document.getElementById('layoutVisualization') as HTMLElement;
         this.infoPanel = document.getElementById('infoPanel') as HTMLElement;
         this.infoContent = document.getElementById('infoContent') as HTMLElement;
         this.clearInfoBtn = document.getElementById('clearInfo') as HTMLElement;
+        this.exportTraceBtn = document.getElementById('exportTrace') as HTMLElement;
 
         this.initializeEventListeners();
         this.loadModule();
@@ -63,6 +267,52 @@ class CxxLayoutVisualizer {
         this.clearInfoBtn.addEventListener('click', () => {
             this.hideInfo();
         });
+        this.exportTraceBtn.addEventListener('click', () => this.exportTimeTrace());
+        this.diffToggle.addEventListener('change', () => this.setDiffMode(this.diffToggle.checked));
+        // Comparisons follow edits on either side
+        const scheduleDiff = () => {
+            if (!this.diffToggle.checked) return;
+            clearTimeout(this.diffTimer);
+            this.diffTimer = window.setTimeout(() => this.analyzeCode(), DIFF_REANALYZE_DELAY);
+        };
+        [this.codeEditor, this.codeEditorB].forEach(editor => editor.addEventListener('input', scheduleDiff));
+        [this.targetSelect, this.targetSelectB].forEach(select => select.addEventListener('change', scheduleDiff));
+
+        // Rendered records are reused across analyses, so their events are
+        // handled here rather than by listeners bound to one record.
+        this.recordList.querySelector('.record-items')?.addEventListener('click', e => {
+            const item = (e.target as HTMLElement).closest<HTMLElement>('.record-item');
+            if (item) {
+                this.select(item.dataset.recordKey ?? null);
+            }
+        });
+        this.layoutVisualization.addEventListener('click', e => {
+            const reset = (e.target as HTMLElement).closest('.what-if-reset');
+            const record = this.recordAt(reset);
+            if (record) {
+                this.whatIf.delete(record.id);
+                this.displayLayouts();
+            }
+        });
+        this.layoutVisualization.addEventListener('mouseover', e => this.highlight(e.target, true));
+        this.layoutVisualization.addEventListener('mouseout', e => this.highlight(e.target, false));
+        this.addReorderEventListeners();
+    }
+
+    private setDiffMode(enabled: boolean): void {
+        this.diffInputs.style.display = enabled ? 'flex' : 'none';
+        if (enabled && !this.codeEditorB.value.trim()) {
+            this.codeEditorB.value = this.codeEditor.value;
+        }
+        this.diffElements.clear();
+        this.layoutVisualization.innerHTML = '';
+        this.recordList.style.display = 'none';
+        this.summaryPanel.style.display = 'none';
+        if (enabled) {
+            this.analyzeCode();
+        } else if (this.records.length > 0) {
+            this.displayResults();
+        }
     }
 
     private async loadModule(): Promise<void> {
@@ -72,12 +322,45 @@ class CxxLayoutVisualizer {
                     this.stderr += text + '\n';
                 }
             }) as CxxLayoutModule;
-            console.log('CxxLayout module loaded successfully');
+            this.scheduleWarmUp();
         } catch (err) {
             this.showError('Failed to load CxxLayout module: ' + (err as Error).message);
         }
     }
 
+    // Warms the engine up once the page is idle, unless an analysis starts
+    // first and does it anyway. It blocks the main thread while it runs.
+    private scheduleWarmUp(): void {
+        if (typeof this.module?._warmUp !== 'function') return;
+        const warmUp = () => {
+            this.cancelWarmUp = () => {};
+            if (!this.module || this.firstAnalysisDone) return;
+            this.module._warmUp!();
+            this.stderr = '';
+        };
+        if (typeof requestIdleCallback === 'function') {
+            const id = requestIdleCallback(warmUp, { timeout: WARM_UP_TIMEOUT });
+            this.cancelWarmUp = () => cancelIdleCallback(id);
+        } else {
+            const id = window.setTimeout(warmUp, WARM_UP_TIMEOUT);
+            this.cancelWarmUp = () => clearTimeout(id);
+        }
+    }
+
+    // The header archive is only fetched once some input includes a header,
+    // so inputs without #include never pay for it.
+    private loadHeaders(): Promise<HeaderArchive | null> {
+        if (!this.headers && this.module) {
+            const module = this.module;
+            this.headers = HeaderArchive.mount(module, new URL('../wasm/', import.meta.url))
+                .catch(err => {
+                    console.warn('Standard library headers unavailable:', err);
+                    return null;
+                });
+        }
+        return this.headers ?? Promise.resolve(null);
+    }
+
     private showError(message: string): void {
         this.error.textContent = message;
         this.error.style.display = 'block';
@@ -99,9 +382,73 @@ class CxxLayoutVisualizer {
     private hideInfo(): void {
         this.infoPanel.style.display = 'none';
         this.infoContent.textContent = '';
+        this.exportTraceBtn.style.display = 'none';
+    }
+
+    private showOutput(traceSummary: string): void {
+        const output = [this.stderr.trim(), traceSummary].filter(s => s).join('\n\n');
+        if (output) {
+            this.showInfo(output);
+        }
+        if (this.timeTrace) {
+            this.exportTraceBtn.style.display = 'block';
+        }
+    }
+
+    private formatTimeTraceSummary(summary: TimeTraceSummary): string {
+        const ms = (us: number) => `${(us / 1000).toFixed(1)} ms`.padStart(10);
+        const lines = [`Time trace: ${(summary.total / 1000).toFixed(1)} ms total`];
+        if (summary.headers.length > 0) {
+            lines.push('Top headers by parse time (inclusive):');
+            summary.headers.forEach(h => lines.push(`${ms(h.dur)}  ${h.name}`));
+        }
+        if (summary.instantiations.length > 0) {
+            lines.push('Top template instantiations:');
+            summary.instantiations.forEach(i => lines.push(`${ms(i.dur)}  ${i.kind} ${i.name}`));
+        }
+        return lines.join('\n');
+    }
+
+    private exportTimeTrace(): void {
+        if (!this.timeTrace) return;
+        const blob = new Blob([this.timeTrace], { type: 'application/json' });
+        const url = URL.createObjectURL(blob);
+        const link = document.createElement('a');
+        link.href = url;
+        link.download = 'cxxlayout-time-trace.json';
+        link.click();
+        // Revoking right away cancels the download in some browsers.
+        setTimeout(() => URL.revokeObjectURL(url), 0);
+    }
+
+    // Standard library headers are only mounted for sources that include
+    // any.
+    private async buildArgs(source: string, args: string): Promise<string> {
+        if (/^\s*#\s*(include|import)\s*</m.test(source)) {
+            const headers = await this.loadHeaders();
+            if (headers) {
+                args += ' ' + headers.index.args;
+                await headers.preload().catch(err => {
+                    console.warn('Header pack preload failed, reading headers one at a time:', err);
+                });
+            }
+        }
+        return args;
+    }
+
+    // Results of sources that were given the header archive depend on its
+    // contents as well, so a new pack doesn't serve stale layouts.
+    private async resultKey(source: string, args: string, filter: string): Promise<string> {
+        const headers = this.headers ? await this.headers : null;
+        const version = headers && args.includes(headers.index.args) ? headers.index.version : '';
+        return ResultCache.key(source, args, filter, version);
     }
 
     private async analyzeCode(): Promise<void> {
+        this.cancelWarmUp();
+        if (this.diffToggle.checked) {
+            return this.analyzeDiff();
+        }
         if (!this.module) {
             this.showError('Module not loaded yet. Please wait and try again.');
             return;
@@ -117,142 +464,410 @@ class CxxLayoutVisualizer {
         this.error.style.display = 'none';
         this.hideInfo();
         this.stderr = '';
+        this.timeTrace = null;
 
         try {
-            const args = this.targetSelect.value;
-            const encoder = new TextEncoder();
-
-            const argsEncoded = encoder.encode(args);
-            const argsPtr = this.module._malloc(argsEncoded.length + 1);
-            this.module.stringToUTF8(args, argsPtr, argsEncoded.length + 1);
-            this.module._setArgs(argsPtr);
-            this.module._free(argsPtr);
-
-            const sourceEncoded = encoder.encode(source);
-            const sourcePtr = this.module._malloc(sourceEncoded.length + 1);
-            this.module.stringToUTF8(source, sourcePtr, sourceEncoded.length + 1);
-            this.module._analyzeSource(sourcePtr);
-            this.module._free(sourcePtr);
-
-            const resultPtr = this.module._getRecordList();
-            const resultJson = this.module.UTF8ToString(resultPtr);
-            this.module._free(resultPtr);
-            this.records = JSON.parse(resultJson) as RecordInfo[];
-            
+            // Engines built before the time trace exports can't trace.
+            const traceEnabled = this.timeTraceToggle.checked &&
+                typeof this.module._getTimeTrace === 'function' &&
+                typeof this.module._getTimeTraceSummary === 'function';
+            const args = await this.buildArgs(source,
+                this.targetSelect.value + (traceEnabled ? ' -ftime-trace' : ''));
+            const filter = this.recordFilter.value.trim();
+            this.analyzed = { source, args, filter };
+            this.whatIf.clear();
+
+            // Traced runs are never served from the cache, the trace is the
+            // point of running them.
+            const cacheKey = traceEnabled ? null : await this.resultKey(source, args, filter);
+            const cached = cacheKey ? await this.cache.get(cacheKey) : undefined;
+            if (cached) {
+                this.showCachedResult(cached);
+                return;
+            }
+
+            if (this.pruneToggle.checked !== this.pruneEnabled && this.module._setHeaderPruning) {
+                this.pruneEnabled = this.pruneToggle.checked;
+                this.module._setHeaderPruning(this.pruneEnabled ? 1 : 0);
+            }
+
+            let traceSummary = '';
+            let summary: LayoutSummary | undefined;
+            const result = this.runEngine(source, args, filter, () => {
+                summary = this.readSummary();
+                this.firstAnalysisDone = true;
+                if (traceEnabled) {
+                    this.timeTrace = this.takeString(this.module!._getTimeTrace!());
+                    const summary = JSON.parse(this.takeString(this.module!._getTimeTraceSummary!())) as TimeTraceSummary;
+                    traceSummary = this.formatTimeTraceSummary(summary);
+                }
+            });
+            this.records = result.records;
+            this.layouts = result.layouts;
+            this.summary = summary ?? null;
+
+            if (cacheKey) {
+                this.cache.put(cacheKey, {
+                    records: this.records,
+                    layouts: Array.from(this.layouts),
+                    stderr: this.stderr,
+                    summary,
+                });
+            }
+
             if (this.records.length === 0) {
                 this.showError('No records found. Make sure your code contains struct or class definitions.');
-                return;
+            } else {
+                this.displayResults();
             }
+            this.showOutput(traceSummary);
+        } catch (err) {
+            this.showError('Analysis failed: ' + (err as Error).message);
+        } finally {
+            this.showLoading(false);
+        }
+    }
+
+    private async analyzeDiff(): Promise<void> {
+        if (!this.module) {
+            this.showError('Module not loaded yet. Please wait and try again.');
+            return;
+        }
+        const sources = [this.codeEditor.value.trim(), this.codeEditorB.value.trim()];
+        if (sources.some(source => !source)) {
+            this.showError('Please enter C++ code on both sides to compare.');
+            return;
+        }
 
-            this.layouts.clear();
-            for (const record of this.records) {
+        this.showLoading(true);
+        this.error.style.display = 'none';
+        this.hideInfo();
+        try {
+            const filter = this.recordFilter.value.trim();
+            const targets = [this.targetSelect.value, this.targetSelectB.value];
+            const output: string[] = [];
+            for (const side of [0, 1]) {
+                const args = await this.buildArgs(sources[side], targets[side]);
+                const key = await this.resultKey(sources[side], args, filter);
+                // Only the side that was edited is analyzed again
+                if (this.diffSides[side]?.key !== key) {
+                    this.diffSides[side] = { key, result: await this.analyzeSide(sources[side], args, filter, key) };
+                }
+                const stderr = this.diffSides[side]!.result.stderr.trim();
+                if (stderr) {
+                    output.push(`[${side === 0 ? 'A' : 'B'}]\n${stderr}`);
+                }
+            }
+            this.displayDiff(this.diffSides[0]!.result, this.diffSides[1]!.result);
+            if (output.length > 0) {
+                this.showInfo(output.join('\n\n'));
+            }
+        } catch (err) {
+            this.showError('Analysis failed: ' + (err as Error).message);
+        } finally {
+            this.showLoading(false);
+        }
+    }
+
+    private async analyzeSide(source: string, args: string, filter: string, key: string): Promise<AnalysisResult> {
+        const cached = await this.cache.get(key);
+        if (cached) return cached;
+        this.stderr = '';
+        // Single mode shares the cache entry, and shows its summary.
+        let summary: LayoutSummary | undefined;
+        const { records, layouts } = this.runEngine(source, args, filter, () => {
+            summary = this.readSummary();
+        });
+        const result: AnalysisResult = { records, layouts: Array.from(layouts), stderr: this.stderr, summary };
+        this.cache.put(key, result);
+        return result;
+    }
+
+    // Runs one analysis through the engine and decodes its records and
+    // layouts. `inspect` runs while the engine still holds the analysis, for
+    // callers that need more out of it than the layouts.
+    private runEngine(source: string, args: string, filter: string,
+                      inspect?: () => void): { records: RecordInfo[]; layouts: Map<string, RecordLayout> } {
+        const module = this.module!;
+        const hasRecordFilter = typeof module._setRecordFilter === 'function';
+        this.withString(args, ptr => module._setArgs(ptr));
+        if (hasRecordFilter) {
+            this.withString(filter, ptr => module._setRecordFilter!(ptr));
+        }
+        this.withString(source, ptr => module._analyzeSource(ptr));
+
+        try {
+            inspect?.();
+            let records = JSON.parse(this.takeString(module._getRecordList())) as RecordInfo[];
+            // Engines without the filter export analyze every record, so the
+            // list is filtered here instead, by the same unanchored search.
+            const pattern = !hasRecordFilter && filter ? compileFilter(filter) : null;
+            if (pattern) {
+                records = records.filter(record => pattern.test(record.name));
+            }
+            const layouts = new Map<string, RecordLayout>();
+            for (const record of records) {
                 try {
                     let recordId: any = record.id;
                     let layoutPtr: number;
                     try {
-                        layoutPtr = this.module._getLayoutForRecord(recordId);
+                        layoutPtr = module._getLayoutForRecord(recordId);
                     } catch (e) {
                         recordId = parseInt(record.id);
-                        layoutPtr = this.module._getLayoutForRecord(recordId);
+                        layoutPtr = module._getLayoutForRecord(recordId);
                     }
-                    const layoutJson = this.module.UTF8ToString(layoutPtr);
-                    this.module._free(layoutPtr);
-                    const layout = JSON.parse(layoutJson) as RecordLayout;
-                    this.layouts.set(record.id, layout);
+                    const layout = JSON.parse(this.takeString(layoutPtr)) as RecordLayout;
+                    layouts.set(record.id, layout);
                 } catch (err) {
                     console.error(`Failed to get layout for record ${record.name} (${record.id}):`, err);
                 }
             }
+            return { records, layouts };
+        } finally {
+            module._cleanup();
+        }
+    }
 
-            this.displayResults();
-            this.module._cleanup();
-            
-            if (this.stderr.trim()) {
-                this.showInfo(this.stderr.trim());
-            }
-        } catch (err) {
-            this.showError('Analysis failed: ' + (err as Error).message);
+    // Engines without the summary export show no summary panel.
+    private readSummary(): LayoutSummary | undefined {
+        const getSummary = this.module!._getSummary;
+        if (typeof getSummary !== 'function') return undefined;
+        return JSON.parse(this.takeString(getSummary())) as LayoutSummary;
+    }
+
+    private withString<T>(value: string, fn: (ptr: number) => T): T {
+        const module = this.module!;
+        const size = new TextEncoder().encode(value).length + 1;
+        const ptr = module._malloc(size);
+        module.stringToUTF8(value, ptr, size);
+        try {
+            return fn(ptr);
         } finally {
-            this.showLoading(false);
+            module._free(ptr);
         }
     }
 
+    private takeString(ptr: number): string {
+        const value = this.module!.UTF8ToString(ptr);
+        this.module!._free(ptr);
+        return value;
+    }
+
+    private showCachedResult(result: AnalysisResult): void {
+        this.records = result.records;
+        this.layouts = new Map(result.layouts);
+        this.stderr = result.stderr;
+        this.summary = result.summary ?? null;
+        if (this.records.length === 0) {
+            this.showError('No records found. Make sure your code contains struct or class definitions.');
+        } else {
+            this.displayResults();
+        }
+        this.showOutput('');
+    }
+
     private displayResults(): void {
+        this.recordKeys = keyRecords(this.records);
+        this.recordsByKey = new Map(this.records.map(record => [this.recordKeys.get(record.id)!, record]));
+        pruneKeyed(this.recordElements, key => this.recordsByKey.has(key));
+        if (this.selectedKey !== null && !this.recordsByKey.has(this.selectedKey)) {
+            this.selectedKey = null;
+        }
+        this.displaySummary();
         this.displayRecordList();
-        this.displayAllLayouts();
+        this.displayLayouts();
     }
 
-    private displayRecordList(): void {
-        const recordItems = this.recordList.querySelector('.record-items') as HTMLElement;
-        if (!recordItems) return;
-        
-        recordItems.innerHTML = '';
-
-        const showAllItem = document.createElement('div');
-        showAllItem.className = 'record-item';
-        showAllItem.textContent = 'Show All';
-        showAllItem.style.fontWeight = '600';
-        showAllItem.style.fontStyle = 'italic';
-        showAllItem.addEventListener('click', () => {
-            this.recordList.querySelectorAll('.record-item').forEach(item => {
-                item.classList.remove('selected');
+    private displaySummary(): void {
+        const summary = this.summary;
+        this.summaryPanel.innerHTML = '';
+        if (!summary || summary.records === 0) {
+            this.summaryPanel.style.display = 'none';
+            return;
+        }
+
+        const stats = document.createElement('div');
+        stats.className = 'summary-stats';
+        const percent = summary.totalBytes > 0 ? (100 * summary.paddingBytes / summary.totalBytes).toFixed(1) : '0.0';
+        stats.textContent = `${summary.records} records • ${summary.totalBytes}B total • ` +
+            `${summary.paddingBytes}B padding (${percent}%)`;
+        this.summaryPanel.appendChild(stats);
+
+        const histogram = document.createElement('div');
+        histogram.className = 'summary-histogram';
+        const maxCount = Math.max(...summary.histogram.map(b => b.count));
+        summary.histogram.forEach(bucket => {
+            const column = document.createElement('div');
+            column.className = 'histogram-column';
+            column.title = `≤${bucket.max}B: ${bucket.count} record${bucket.count === 1 ? '' : 's'}`;
+            const bar = document.createElement('div');
+            bar.className = 'histogram-bar';
+            bar.style.height = `${maxCount > 0 ? (100 * bucket.count / maxCount) : 0}%`;
+            const label = document.createElement('span');
+            label.className = 'histogram-label';
+            label.textContent = `${bucket.max}`;
+            column.append(bar, label);
+            histogram.appendChild(column);
+        });
+        this.summaryPanel.appendChild(histogram);
+
+        const tabs = document.createElement('div');
+        tabs.className = 'summary-tabs';
+        SUMMARY_LISTS.forEach(([list, title]) => {
+            const tab = document.createElement('button');
+            tab.className = `summary-tab${list === this.summaryList ? ' selected' : ''}`;
+            tab.textContent = title;
+            tab.addEventListener('click', () => {
+                this.summaryList = list;
+                this.summarySort.column = null;
+                this.displaySummary();
             });
-            showAllItem.classList.add('selected');
-            this.displayAllLayouts();
+            tabs.appendChild(tab);
         });
-        recordItems.appendChild(showAllItem);
+        this.summaryPanel.appendChild(tabs);
+        this.summaryPanel.appendChild(this.createSummaryTable(summary[this.summaryList]));
+        this.summaryPanel.style.display = 'block';
+    }
 
-        this.records.forEach(record => {
-            const recordItem = document.createElement('div');
-            recordItem.className = 'record-item';
-            recordItem.textContent = `${record.name} (${record.id})`;
-            recordItem.addEventListener('click', () => {
-                this.recordList.querySelectorAll('.record-item').forEach(item => {
-                    item.classList.remove('selected');
-                });
-                recordItem.classList.add('selected');
-                this.displaySingleLayout(record.id);
+    // Entries come ranked by the engine; a column header re-sorts them.
+    private createSummaryTable(entries: SummaryEntry[]): HTMLElement {
+        const { column, descending } = this.summarySort;
+        const value = (entry: SummaryEntry, col: SummaryColumn): number | string =>
+            col === 'paddingRatio' ? paddingRatio(entry) : entry[col];
+        const sorted = column === null ? entries : [...entries].sort((a, b) => {
+            const x = value(a, column);
+            const y = value(b, column);
+            const order = x < y ? -1 : x > y ? 1 : 0;
+            return descending ? -order : order;
+        });
+
+        const table = document.createElement('table');
+        table.className = 'summary-table';
+        const headRow = table.createTHead().insertRow();
+        SUMMARY_COLUMNS.forEach(([col, title]) => {
+            const th = document.createElement('th');
+            th.textContent = title + (col === column ? (descending ? ' ▾' : ' ▴') : '');
+            th.addEventListener('click', () => {
+                this.summarySort = { column: col, descending: col === column ? !descending : col !== 'name' };
+                this.displaySummary();
             });
-            recordItems.appendChild(recordItem);
+            headRow.appendChild(th);
         });
 
-        showAllItem.classList.add('selected');
-        this.recordList.style.display = 'block';
+        const body = table.createTBody();
+        sorted.forEach(entry => {
+            const row = body.insertRow();
+            row.title = 'Show this record';
+            [entry.name, `${entry.size}B`, `${entry.padding}B`,
+                `${(100 * paddingRatio(entry)).toFixed(1)}%`, `${entry.embedded}`].forEach(text => {
+                row.insertCell().textContent = text;
+            });
+            row.addEventListener('click', () => this.selectRecord(entry.id));
+        });
+        return table;
     }
 
-    private displayAllLayouts(): void {
-        this.layoutVisualization.innerHTML = '';
+    private selectRecord(recordId: string): void {
+        this.select(this.recordKeys.get(recordId) ?? null);
+        this.layoutVisualization.scrollIntoView({ behavior: 'smooth', block: 'start' });
+    }
+
+    private select(key: string | null): void {
+        this.selectedKey = key;
+        this.recordList.querySelectorAll<HTMLElement>('.record-item').forEach(item => {
+            item.classList.toggle('selected', (item.dataset.recordKey ?? null) === key);
+        });
+        this.displayLayouts();
+    }
+
+    private recordAt(target: Element | null): RecordInfo | undefined {
+        const recordBox = target?.closest<HTMLElement>('.record-box[data-record-key]');
+        return recordBox ? this.recordsByKey.get(recordBox.dataset.recordKey!) : undefined;
+    }
+
+    private displayRecordList(): void {
+        const recordItems = this.recordList.querySelector('.record-items') as HTMLElement;
+        if (!recordItems) return;
+
+        // The "Show All" item has no record key; record keys are never empty.
+        const entries: KeyedEntry[] = [{ key: '', signature: '', create: () => {
+            const showAllItem = document.createElement('div');
+            showAllItem.className = 'record-item';
+            showAllItem.textContent = 'Show All';
+            showAllItem.style.fontWeight = '600';
+            showAllItem.style.fontStyle = 'italic';
+            return showAllItem;
+        } }];
         this.records.forEach(record => {
-            const layout = this.layouts.get(record.id);
-            if (layout) {
-                const recordElement = this.createRecordElement(record, layout);
-                this.layoutVisualization.appendChild(recordElement);
-            }
+            const key = this.recordKeys.get(record.id)!;
+            const title = record.file ? `${record.file}:${record.line}` : '';
+            entries.push({ key, signature: JSON.stringify([record.name, title]), create: () => {
+                const recordItem = document.createElement('div');
+                recordItem.className = 'record-item';
+                recordItem.textContent = record.name;
+                recordItem.dataset.recordKey = key;
+                if (title) {
+                    recordItem.title = title;
+                }
+                return recordItem;
+            } });
+        });
+        reconcile(recordItems, this.recordItems, entries);
+        pruneKeyed(this.recordItems, key => key === '' || this.recordsByKey.has(key));
+
+        recordItems.querySelectorAll<HTMLElement>('.record-item').forEach(item => {
+            item.classList.toggle('selected', (item.dataset.recordKey ?? null) === this.selectedKey);
         });
+        this.recordList.style.display = 'block';
     }
 
-    private displaySingleLayout(recordId: string): void {
-        this.layoutVisualization.innerHTML = '';
-        const record = this.records.find(r => r.id === recordId);
-        const layout = this.layouts.get(recordId);
-        if (record && layout) {
-            const recordElement = this.createRecordElement(record, layout);
-            this.layoutVisualization.appendChild(recordElement);
-        }
+    private displayedLayout(recordId: string): RecordLayout | undefined {
+        return this.whatIf.get(recordId) ?? this.layouts.get(recordId);
+    }
+
+    // Shows the selected record, or all of them.
+    private displayLayouts(): void {
+        const entries: KeyedEntry[] = [];
+        this.records.forEach(record => {
+            const key = this.recordKeys.get(record.id)!;
+            const layout = this.displayedLayout(record.id);
+            if (!layout || (this.selectedKey !== null && key !== this.selectedKey)) return;
+            const original = this.layouts.get(record.id);
+            const signature = layoutSignature([record.name, layout, layout !== original ? original : null]);
+            entries.push({ key, signature, create: () => this.createRecordElement(record, key, layout) });
+        });
+        reconcile(this.layoutVisualization, this.recordElements, entries);
     }
 
-    private createRecordElement(record: RecordInfo, layout: RecordLayout): HTMLElement {
+    private createRecordElement(record: RecordInfo, key: string, layout: RecordLayout): HTMLElement {
         const recordBox = document.createElement('div');
         recordBox.className = 'record-box';
+        recordBox.dataset.recordKey = key;
 
+        const padding = paddingBytes(layout.subFields, layout.size);
         const header = document.createElement('div');
         header.className = 'record-header';
         header.innerHTML = `
             <span>${record.name}</span>
-            <span>${layout.size}B • ${layout.align}B align</span>
+            <span>${layout.size}B • ${layout.align}B align • ${padding}B padding</span>
         `;
         recordBox.appendChild(header);
 
+        const original = this.layouts.get(record.id);
+        if (original && layout !== original) {
+            recordBox.classList.add('what-if');
+            const banner = document.createElement('div');
+            banner.className = 'what-if-banner';
+            const delta = layout.size - original.size;
+            banner.textContent = `Reordered preview: ${delta > 0 ? '+' : ''}${delta}B ` +
+                `(was ${original.size}B, ${paddingBytes(original.subFields, original.size)}B padding)`;
+            const resetBtn = document.createElement('button');
+            resetBtn.className = 'what-if-reset';
+            resetBtn.textContent = 'Reset';
+            banner.appendChild(resetBtn);
+            recordBox.appendChild(banner);
+        }
+
         if (layout.subFields.length > 0 || layout.size > 0) {
             const memoryBar = this.createMemoryBar(layout);
             recordBox.appendChild(memoryBar);
@@ -269,17 +884,279 @@ class CxxLayoutVisualizer {
             `;
             recordBox.appendChild(fieldHeader);
 
-            layout.subFields.forEach(field => {
+            layout.subFields.forEach((field, index) => {
                 const fieldElement = this.createCompactFieldElement(field);
+                if (isDataMember(field)) {
+                    fieldElement.draggable = true;
+                    fieldElement.dataset.fieldIndex = `${index}`;
+                }
                 recordBox.appendChild(fieldElement);
             });
         }
 
-        this.addHighlightEventListeners(recordBox, layout);
+        return recordBox;
+    }
+
+    private addReorderEventListeners(): void {
+        const container = this.layoutVisualization;
+        // Only fields of the record a drag started in are drop targets
+        const fieldAt = (target: EventTarget | null): HTMLElement | null => {
+            const fieldEl = (target as HTMLElement | null)?.closest<HTMLElement>('.field[data-field-index]');
+            const recordBox = fieldEl?.closest<HTMLElement>('.record-box[data-record-key]');
+            return fieldEl && recordBox?.dataset.recordKey === this.dragging?.key ? fieldEl : null;
+        };
+        const clearDropTarget = () => {
+            container.querySelectorAll('.drop-target').forEach(el => el.classList.remove('drop-target'));
+        };
+
+        container.addEventListener('dragstart', e => {
+            const fieldEl = (e.target as HTMLElement).closest<HTMLElement>('.field[data-field-index]');
+            const recordBox = fieldEl?.closest<HTMLElement>('.record-box[data-record-key]');
+            if (!fieldEl || !recordBox) return;
+            this.dragging = { key: recordBox.dataset.recordKey!, index: Number(fieldEl.dataset.fieldIndex) };
+            e.dataTransfer?.setData('text/plain', fieldEl.dataset.fieldIndex ?? '');
+            fieldEl.classList.add('dragging');
+        });
+        container.addEventListener('dragend', () => {
+            this.dragging = null;
+            clearDropTarget();
+            container.querySelectorAll('.dragging').forEach(el => el.classList.remove('dragging'));
+        });
+        container.addEventListener('dragover', e => {
+            const target = fieldAt(e.target);
+            if (!target) return;
+            e.preventDefault();
+            clearDropTarget();
+            target.classList.add('drop-target');
+        });
+        container.addEventListener('drop', e => {
+            const target = fieldAt(e.target);
+            const record = this.recordAt(target);
+            const layout = record ? this.displayedLayout(record.id) : undefined;
+            if (!this.dragging || !record || !layout) return;
+            e.preventDefault();
+            const from = this.dragging.index;
+            const to = Number(target!.dataset.fieldIndex);
+            this.dragging = null;
+            if (from !== to) {
+                this.reorderField(record, layout, from, to);
+            }
+        });
+    }
+
+    private async reorderField(record: RecordInfo, shown: RecordLayout, from: number, to: number): Promise<void> {
+        const original = this.layouts.get(record.id);
+        if (!original) return;
+        const fields = [...shown.subFields];
+        const [moved] = fields.splice(from, 1);
+        fields.splice(to, 0, moved);
+
+        const preview = this.layoutLocally(original, fields) ?? this.layoutByReanalysis(record, original, fields);
+        if (preview) {
+            this.whatIf.set(record.id, preview);
+            this.displayLayouts();
+        }
+    }
 
+    // Lays out reordered fields with the client-side Itanium rules. Only
+    // records of plain data members whose original layout the rules
+    // reproduce qualify. Without the alignment each member is laid out
+    // with, an alignas on a member would go unnoticed.
+    private layoutLocally(original: RecordLayout, fields: FieldLayout[]): RecordLayout | null {
+        if (!original.subFields.every(f => (f.fieldType === 'Simple' || f.fieldType === 'Record') &&
+                                           f.fieldAlign !== undefined)) {
+            return null;
+        }
+        const model = calibrate(original.subFields, original.size, original.align);
+        if (!model) return null;
+        const computed = layoutFields(fields, model);
+        return {
+            ...original,
+            size: computed.size,
+            align: computed.align,
+            subFields: fields.map((field, i) => ({ ...field, offset: computed.offsets[i] })),
+        };
+    }
+
+    // Everything else (bitfields, bases, packing the rules can't explain)
+    // is laid out by clang, from a copy of the source with the member
+    // declarations permuted.
+    private layoutByReanalysis(record: RecordInfo, original: RecordLayout, fields: FieldLayout[]): RecordLayout | null {
+        if (!this.module || !this.analyzed) return null;
+        const source = this.permuteMembers(this.analyzed.source, original.subFields, fields);
+        if (source === null) {
+            this.showError(`Cannot reorder ${record.name}: its members are not declared one per declaration in the input.`);
+            return null;
+        }
+        try {
+            const result = this.runEngine(source, this.analyzed.args, this.analyzed.filter);
+            const match = result.records.find(r => r.name === record.name);
+            const layout = match ? result.layouts.get(match.id) : undefined;
+            if (!layout) {
+                this.showError(`Re-analysis of the reordered ${record.name} failed.`);
+                return null;
+            }
+            // Keep the original's source ranges so further drags permute the
+            // original input again.
+            const ranges = new Map(original.subFields.map(f => [f.name, f.range]));
+            layout.subFields.forEach(f => f.range = ranges.get(f.name));
+            return layout;
+        } catch (err) {
+            this.showError('Re-analysis failed: ' + (err as Error).message);
+            return null;
+        }
+    }
+
+    private permuteMembers(source: string, original: FieldLayout[], order: FieldLayout[]): string | null {
+        const members = original.filter(isDataMember);
+        const reordered = order.filter(isDataMember);
+        if (members.some(f => !f.range || !f.name)) return null;
+        const slots = [...members].sort((a, b) => a.range![0] - b.range![0]);
+        for (let i = 1; i < slots.length; i++) {
+            // `int a, b;` declares both members in overlapping ranges
+            if (slots[i].range![0] < slots[i - 1].range![1]) return null;
+        }
+
+        const bytes = new TextEncoder().encode(source);
+        const decoder = new TextDecoder();
+        const byName = new Map(members.map(f => [f.name, f]));
+        let result = '';
+        let pos = 0;
+        slots.forEach((slot, i) => {
+            const member = byName.get(reordered[i].name)!;
+            result += decoder.decode(bytes.subarray(pos, slot.range![0]));
+            result += decoder.decode(bytes.subarray(member.range![0], member.range![1]));
+            pos = slot.range![1];
+        });
+        return result + decoder.decode(bytes.subarray(pos));
+    }
+
+    private static layoutsByName(result: AnalysisResult): Map<string, RecordLayout> {
+        const layouts = new Map(result.layouts);
+        const byName = new Map<string, RecordLayout>();
+        for (const record of result.records) {
+            const layout = layouts.get(record.id);
+            if (layout && !byName.has(record.name)) {
+                byName.set(record.name, layout);
+            }
+        }
+        return byName;
+    }
+
+    // Renders the records of both sides paired by qualified name. Pairs
+    // whose layouts did not change since the last comparison keep their
+    // elements.
+    private displayDiff(a: AnalysisResult, b: AnalysisResult): void {
+        const left = CxxLayoutVisualizer.layoutsByName(a);
+        const right = CxxLayoutVisualizer.layoutsByName(b);
+        const names = [...left.keys(), ...[...right.keys()].filter(name => !left.has(name))];
+        reconcile(this.layoutVisualization, this.diffElements, names.map(name => {
+            const l = left.get(name);
+            const r = right.get(name);
+            const signature = layoutSignature([l ?? null, r ?? null]);
+            return { key: name, signature, create: () => this.createDiffElement(name, l, r) };
+        }));
+        pruneKeyed(this.diffElements, name => left.has(name) || right.has(name));
+
+        if (names.length === 0) {
+            this.showError('No records found. Make sure your code contains struct or class definitions.');
+        }
+    }
+
+    private createDiffElement(name: string, l: RecordLayout | undefined, r: RecordLayout | undefined): HTMLElement {
+        const recordBox = document.createElement('div');
+        recordBox.className = 'record-box diff-record';
+        const header = document.createElement('div');
+        header.className = 'record-header';
+        const title = document.createElement('span');
+        title.textContent = name;
+        header.appendChild(title);
+        recordBox.appendChild(header);
+
+        if (!l || !r) {
+            const present = (l ?? r)!;
+            recordBox.classList.add(l ? 'diff-removed' : 'diff-added');
+            const summary = document.createElement('span');
+            summary.textContent = `only in ${l ? 'A' : 'B'} • ${present.size}B`;
+            header.appendChild(summary);
+            recordBox.appendChild(this.createDiffBar(l ? 'A' : 'B', present, new Set()));
+            return recordBox;
+        }
+
+        const summary = document.createElement('span');
+        const compare = (label: string, before: number, after: number) => {
+            const item = document.createElement('span');
+            item.textContent = before === after
+                ? `${after}B ${label}`
+                : `${before}B → ${after}B ${label} (${after > before ? '+' : ''}${after - before})`;
+            if (before !== after) {
+                item.className = `diff-delta ${after > before ? 'grew' : 'shrank'}`;
+            }
+            return item;
+        };
+        summary.append(
+            compare('size', l.size, r.size), ' • ',
+            compare('align', l.align, r.align), ' • ',
+            compare('padding', paddingBytes(l.subFields, l.size), paddingBytes(r.subFields, r.size)));
+        header.appendChild(summary);
+
+        const key = (field: FieldLayout) => field.name || `${field.fieldType}:${field.type}`;
+        const before = new Map(l.subFields.map(f => [key(f), f]));
+        const after = new Map(r.subFields.map(f => [key(f), f]));
+        const statusOf = (k: string): FieldDiff => {
+            const x = before.get(k);
+            const y = after.get(k);
+            if (!x) return 'added';
+            if (!y) return 'removed';
+            if (x.size !== y.size) return 'resized';
+            if (x.offset !== y.offset) return 'moved';
+            return null;
+        };
+
+        const changedOffsets = (fields: FieldLayout[]) =>
+            new Set(fields.filter(f => statusOf(key(f)) !== null).map(f => f.offset));
+        recordBox.appendChild(this.createDiffBar('A', l, changedOffsets(l.subFields)));
+        recordBox.appendChild(this.createDiffBar('B', r, changedOffsets(r.subFields)));
+
+        const rows = [...r.subFields, ...l.subFields.filter(f => !after.has(key(f)))];
+        rows.forEach(field => {
+            const k = key(field);
+            const status = statusOf(k);
+            const fieldElement = this.createCompactFieldElement(field);
+            if (status) {
+                fieldElement.classList.add(`diff-${status}`);
+            }
+            const x = before.get(k);
+            const y = after.get(k);
+            if (x && y && x.offset !== y.offset) {
+                fieldElement.querySelector('.field-offset')!.textContent = `@${x.offset}→${y.offset}`;
+            }
+            if (x && y && x.size !== y.size) {
+                fieldElement.querySelector('.field-size')!.textContent = `${x.size}→${y.size}B`;
+            }
+            recordBox.appendChild(fieldElement);
+        });
         return recordBox;
     }
 
+    // A labelled memory bar with the bytes of the fields at `changed`
+    // offsets marked.
+    private createDiffBar(label: string, layout: RecordLayout, changed: Set<number>): HTMLElement {
+        const row = document.createElement('div');
+        row.className = 'diff-bar-row';
+        const labelElement = document.createElement('span');
+        labelElement.className = 'diff-bar-label';
+        labelElement.textContent = label;
+        const memoryBar = this.createMemoryBar(layout);
+        memoryBar.querySelectorAll<HTMLElement>('.memory-segment[data-field-offset]').forEach(segment => {
+            if (changed.has(Number(segment.dataset.fieldOffset))) {
+                segment.classList.add('diff-changed');
+            }
+        });
+        row.append(labelElement, memoryBar);
+        return row;
+    }
+
     private createMemoryBar(layout: RecordLayout): HTMLElement {
         const memoryBar = document.createElement('div');
         memoryBar.className = 'memory-bar';
@@ -346,70 +1223,22 @@ class CxxLayoutVisualizer {
         return fieldDiv;
     }
 
-    private addHighlightEventListeners(recordBox: HTMLElement, layout: RecordLayout): void {
-        const fieldElements = Array.from(recordBox.querySelectorAll('.field[data-field-offset]')) as HTMLElement[];
-        const memorySegments = Array.from(recordBox.querySelectorAll('.memory-segment[data-byte-offset]')) as HTMLElement[];
-
-        const getFieldFromOffset = (offset: string | undefined | null): FieldLayout | undefined => {
-            if (!offset) return undefined;
-            return layout.subFields.find(f => f.offset.toString() === offset);
-        };
-
-        fieldElements.forEach(fieldEl => {
-            fieldEl.addEventListener('mouseover', () => {
-                const field = getFieldFromOffset(fieldEl.dataset.fieldOffset);
-                if (!field) return;
-
-                fieldEl.classList.add('highlight');
-                for (let i = 0; i < field.size; i++) {
-                    const byteOffset = field.offset + i;
-                    const segment = memorySegments.find(s => s.dataset.byteOffset === byteOffset.toString());
-                    segment?.classList.add('highlight');
-                }
-            });
-
-            fieldEl.addEventListener('mouseout', () => {
-                const field = getFieldFromOffset(fieldEl.dataset.fieldOffset);
-                if (!field) return;
-
-                fieldEl.classList.remove('highlight');
-                for (let i = 0; i < field.size; i++) {
-                    const byteOffset = field.offset + i;
-                    const segment = memorySegments.find(s => s.dataset.byteOffset === byteOffset.toString());
-                    segment?.classList.remove('highlight');
-                }
-            });
-        });
-
-        memorySegments.forEach(segmentEl => {
-            segmentEl.addEventListener('mouseover', () => {
-                const field = getFieldFromOffset(segmentEl.dataset.fieldOffset);
-                if (!field) return;
-
-                const fieldEl = fieldElements.find(fe => fe.dataset.fieldOffset === field.offset.toString());
-                fieldEl?.classList.add('highlight');
-
-                for (let i = 0; i < field.size; i++) {
-                    const byteOffset = field.offset + i;
-                    const segment = memorySegments.find(s => s.dataset.byteOffset === byteOffset.toString());
-                    segment?.classList.add('highlight');
-                }
-            });
-
-            segmentEl.addEventListener('mouseout', () => {
-                const field = getFieldFromOffset(segmentEl.dataset.fieldOffset);
-                if (!field) return;
-
-                const fieldEl = fieldElements.find(fe => fe.dataset.fieldOffset === field.offset.toString());
-                fieldEl?.classList.remove('highlight');
-
-                for (let i = 0; i < field.size; i++) {
-                    const byteOffset = field.offset + i;
-                    const segment = memorySegments.find(s => s.dataset.byteOffset === byteOffset.toString());
-                    segment?.classList.remove('highlight');
-                }
-            });
-        });
+    // Highlights a field together with its bytes in the memory bar, whichever
+    // of the two is pointed at.
+    private highlight(target: EventTarget | null, on: boolean): void {
+        const el = (target as HTMLElement | null)?.closest<HTMLElement>('[data-field-offset]') ?? null;
+        const record = this.recordAt(el);
+        const layout = record ? this.displayedLayout(record.id) : undefined;
+        const field = layout?.subFields.find(f => f.offset.toString() === el!.dataset.fieldOffset);
+        if (!field) return;
+
+        const recordBox = el!.closest('.record-box')!;
+        recordBox.querySelector(`.field[data-field-offset="${field.offset}"]`)?.classList.toggle('highlight', on);
+        const segments = recordBox.querySelector('.memory-bar')?.children;
+        if (!segments) return;
+        for (let i = field.offset; i < Math.min(field.offset + field.size, segments.length); i++) {
+            segments[i].classList.toggle('highlight', on);
+        }
     }
 
     private getFieldTypeClass(fieldType: string): string {
@@ -433,5 +1262,12 @@ document.addEventListener('DOMContentLoaded', () => {
     new CxxLayoutVisualizer();
 });
 
+// Precache the engine for repeat visits and offline use
+if ('serviceWorker' in navigator) {
+    navigator.serviceWorker.register(new URL('../sw.js', import.meta.url)).catch(err => {
+        console.warn('Service worker registration failed:', err);
+    });
+}
+
 // Export for potential external use
 export { CxxLayoutVisualizer };
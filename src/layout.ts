@@ -0,0 +1,68 @@
+// A small implementation of the Itanium C++ ABI rules for laying out plain
+// data members, used to preview field reorders without a round trip through
+// clang. It only covers records whose members are all non-bitfield data
+// members: no bases, no vptr. Members are placed at the alignment clang
+// reports for them, which already accounts for packing and alignas on the
+// member. Anything else the rules get wrong for a record is detected by
+// `calibrate`, which checks them against clang's layout of the original
+// order first.
+
+export interface LayoutInput {
+    size: number;
+    align: number;
+    // Alignment the member is laid out with, if known
+    fieldAlign?: number;
+}
+
+export interface LayoutModel {
+    // __attribute__((packed)): members are laid out with alignment 1
+    packed: boolean;
+    // Minimum alignment of the record, e.g. from alignas on the record
+    recordAlign: number;
+}
+
+export interface ComputedLayout {
+    offsets: number[];
+    size: number;
+    align: number;
+}
+
+const alignTo = (value: number, align: number): number => Math.ceil(value / align) * align;
+
+export function layoutFields(fields: LayoutInput[], model: LayoutModel): ComputedLayout {
+    let end = 0;
+    let align = Math.max(1, model.recordAlign);
+    const offsets = fields.map(field => {
+        const fieldAlign = Math.max(1, field.fieldAlign ?? (model.packed ? 1 : field.align));
+        align = Math.max(align, fieldAlign);
+        const offset = alignTo(end, fieldAlign);
+        end = offset + field.size;
+        return offset;
+    });
+    // Complete objects are at least one byte large
+    return { offsets, size: Math.max(1, alignTo(end, align)), align };
+}
+
+// Finds a model that reproduces clang's layout of the fields in their
+// declared order, or null if none does.
+export function calibrate(fields: Array<LayoutInput & { offset: number }>,
+                          size: number, align: number): LayoutModel | null {
+    for (const packed of [false, true]) {
+        const model: LayoutModel = { packed, recordAlign: align };
+        const computed = layoutFields(fields, model);
+        if (computed.size === size && computed.align === align &&
+            computed.offsets.every((offset, i) => offset === fields[i].offset)) {
+            return model;
+        }
+    }
+    return null;
+}
+
+// Bytes of a record of the given size not covered by any of its fields.
+export function paddingBytes(fields: Array<LayoutInput & { offset: number }>, size: number): number {
+    const used = new Uint8Array(size);
+    for (const field of fields) {
+        used.fill(1, Math.min(field.offset, size), Math.min(field.offset + field.size, size));
+    }
+    return used.reduce((padding, byte) => padding + (byte ? 0 : 1), 0);
+}
@@ -0,0 +1,122 @@
+// Service worker that precaches the playground and the wasm engine, and
+// serves them cache-first while revalidating in the background, so repeat
+// visits start at local speed and the app keeps working offline.
+//
+// Bump CACHE_VERSION whenever the list below or the engine's build changes;
+// caches of older versions are dropped on activation. An engine rebuild also
+// bumps ENGINE_VERSION in src/index.ts, which drops cached results.
+
+const CACHE_VERSION = 'v3';
+const CACHE_PREFIX = 'cxxlayout-';
+const CACHE_NAME = `${CACHE_PREFIX}${CACHE_VERSION}`;
+
+const PRECACHE = [
+    './',
+    'index.html',
+    'styles.css',
+    'dist/index.js',
+    'dist/cache.js',
+    'dist/headers.js',
+    'dist/layout.js',
+    'wasm/clang-cxx-layout.js',
+    'wasm/clang-cxx-layout.wasm',
+];
+
+// The glue code and the wasm only work as a pair, so they are written to the
+// cache together, by the install of a new CACHE_VERSION, and never
+// revalidated one at a time.
+const ENGINE = new Set(
+    ['wasm/clang-cxx-layout.js', 'wasm/clang-cxx-layout.wasm'].map(path => new URL(path, self.location).href));
+
+// The header archive is optional, and its pack is versioned by the index.
+async function precacheHeaders(cache) {
+    const response = await fetch('wasm/headers.json');
+    if (!response.ok) return;
+    const index = await response.clone().json();
+    await cache.put('wasm/headers.json', response);
+    await cache.add(`wasm/headers.pack?v=${index.version}`);
+}
+
+self.addEventListener('install', event => {
+    event.waitUntil((async () => {
+        const cache = await caches.open(CACHE_NAME);
+        await cache.addAll(PRECACHE);
+        await precacheHeaders(cache).catch(() => {});
+        await self.skipWaiting();
+    })());
+});
+
+self.addEventListener('activate', event => {
+    event.waitUntil((async () => {
+        for (const key of await caches.keys()) {
+            if (key.startsWith(CACHE_PREFIX) && key !== CACHE_NAME) {
+                await caches.delete(key);
+            }
+        }
+        await self.clients.claim();
+    })());
+});
+
+async function cacheFirst(event) {
+    const cache = await caches.open(CACHE_NAME);
+    const cached = await cache.match(event.request);
+    const engine = ENGINE.has(event.request.url);
+    if (cached && engine) {
+        return cached;
+    }
+    const network = fetch(event.request).then(response => {
+        if (response.ok && !engine) {
+            cache.put(event.request, response.clone());
+        }
+        return response;
+    });
+    if (cached) {
+        event.waitUntil(network.catch(() => {}));
+        return cached;
+    }
+    return network;
+}
+
+// Lazy headers are read with range requests against the pack. Serve them
+// from the cached pack, kept in memory since there is one read per header.
+let packBlob = null;
+
+async function rangeResponse(event) {
+    const request = event.request;
+    const match = /^bytes=(\d+)-(\d+)?$/.exec(request.headers.get('range') || '');
+    if (!match) return fetch(request);
+
+    if (!packBlob || packBlob.url !== request.url) {
+        const cache = await caches.open(CACHE_NAME);
+        const cached = await cache.match(request.url);
+        if (!cached) {
+            event.waitUntil(cache.add(request.url).catch(() => {}));
+            return fetch(request);
+        }
+        packBlob = { url: request.url, blob: await cached.blob() };
+    }
+
+    const blob = packBlob.blob;
+    const start = Number(match[1]);
+    const end = Math.min(match[2] ? Number(match[2]) + 1 : blob.size, blob.size);
+    return new Response(blob.slice(start, end), {
+        status: 206,
+        headers: {
+            'Content-Type': 'application/octet-stream',
+            'Content-Length': String(end - start),
+            'Content-Range': `bytes ${start}-${end - 1}/${blob.size}`,
+        },
+    });
+}
+
+self.addEventListener('fetch', event => {
+    const request = event.request;
+    if (request.method !== 'GET' || new URL(request.url).origin !== self.location.origin) {
+        return;
+    }
+    if (request.headers.has('range')) {
+        event.respondWith(rangeResponse(event));
+    } else {
+        event.respondWith(cacheFirst(event));
+    }
+});
@@ -1,11 +1,30 @@
 /// <reference types="emscripten" />
+// Exports marked optional are missing from engines built before them, such
+// as the checked-in build until it is rebuilt; callers check for them.
 export interface CxxLayoutModule extends EmscriptenModule {
     ccall: typeof ccall;
+    FS?: typeof FS;
     _cleanup(): void;
     _getRecordList(): number;
     _analyzeSource(source: number): void;
+    _warmUp?(): void;
     _getLayoutForRecord(id: number): number;
+    _getAllLayouts(): number;
+    _lookupPath(id: number, path: number): number;
     _setArgs(newArgs: number): void;
+    _setTargetDescription(json: number): number;
+    _getTimeTrace?(): number;
+    _getTimeTraceSummary?(): number;
+    _setRecordFilter?(filter: number): void;
+    _setHeaderPruning?(enable: number): void;
+    _setTypeNameStyle(style: number): number;
+    _setAccessAnalysis(enable: number): void;
+    _setCopyAnalysis(minSize: number): void;
+    _getCopySites(): number;
+    _setAbiClassification(enable: number): number;
+    _getIndirectParams(): number;
+    _getPrunedIncludes?(): number;
+    _getSummary?(): number;
     _malloc(size: number): number;
     _free(ptr: number): void;
     stringToUTF8(str: string, outPtr: number, maxBytesToWrite: number): void;